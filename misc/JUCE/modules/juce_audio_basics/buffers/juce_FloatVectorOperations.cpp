@@ -884,6 +884,76 @@ void JUCE_CALLTYPE FloatVectorOperations::convertFixedToFloat (float* dest, cons
    #endif
 }
 
+void JUCE_CALLTYPE FloatVectorOperations::convert (double* dest, const float* src, int num) noexcept
+{
+   #if JUCE_USE_VDSP_FRAMEWORK
+    vDSP_vspdp (src, 1, dest, 1, (vDSP_Length) num);
+   #else
+    int i = 0;
+
+   #if JUCE_USE_SSE_INTRINSICS && defined (__AVX__)
+    for (; i + 8 <= num; i += 8)
+    {
+        const __m256 s = _mm256_loadu_ps (src + i);
+        _mm256_storeu_pd (dest + i,     _mm256_cvtps_pd (_mm256_castps256_ps128 (s)));
+        _mm256_storeu_pd (dest + i + 4, _mm256_cvtps_pd (_mm256_extractf128_ps (s, 1)));
+    }
+   #elif JUCE_USE_SSE_INTRINSICS
+    for (; i + 4 <= num; i += 4)
+    {
+        const __m128 s = _mm_loadu_ps (src + i);
+        _mm_storeu_pd (dest + i,     _mm_cvtps_pd (s));
+        _mm_storeu_pd (dest + i + 2, _mm_cvtps_pd (_mm_movehl_ps (s, s)));
+    }
+   #elif JUCE_USE_ARM_NEON && (defined (__arm64__) || defined (__aarch64__))
+    for (; i + 4 <= num; i += 4)
+    {
+        const float32x4_t s = vld1q_f32 (src + i);
+        vst1q_f64 (dest + i,     vcvt_f64_f32 (vget_low_f32 (s)));
+        vst1q_f64 (dest + i + 2, vcvt_f64_f32 (vget_high_f32 (s)));
+    }
+   #endif
+
+    for (; i < num; ++i)
+        dest[i] = (double) src[i];
+   #endif
+}
+
+void JUCE_CALLTYPE FloatVectorOperations::convert (float* dest, const double* src, int num) noexcept
+{
+   #if JUCE_USE_VDSP_FRAMEWORK
+    vDSP_vdpsp (src, 1, dest, 1, (vDSP_Length) num);
+   #else
+    int i = 0;
+
+   #if JUCE_USE_SSE_INTRINSICS && defined (__AVX__)
+    for (; i + 8 <= num; i += 8)
+    {
+        const __m128 lo = _mm256_cvtpd_ps (_mm256_loadu_pd (src + i));
+        const __m128 hi = _mm256_cvtpd_ps (_mm256_loadu_pd (src + i + 4));
+        _mm256_storeu_ps (dest + i, _mm256_insertf128_ps (_mm256_castps128_ps256 (lo), hi, 1));
+    }
+   #elif JUCE_USE_SSE_INTRINSICS
+    for (; i + 4 <= num; i += 4)
+    {
+        const __m128 lo = _mm_cvtpd_ps (_mm_loadu_pd (src + i));
+        const __m128 hi = _mm_cvtpd_ps (_mm_loadu_pd (src + i + 2));
+        _mm_storeu_ps (dest + i, _mm_movelh_ps (lo, hi));
+    }
+   #elif JUCE_USE_ARM_NEON && (defined (__arm64__) || defined (__aarch64__))
+    for (; i + 4 <= num; i += 4)
+    {
+        const float32x2_t lo = vcvt_f32_f64 (vld1q_f64 (src + i));
+        const float32x2_t hi = vcvt_f32_f64 (vld1q_f64 (src + i + 2));
+        vst1q_f32 (dest + i, vcombine_f32 (lo, hi));
+    }
+   #endif
+
+    for (; i < num; ++i)
+        dest[i] = (float) src[i];
+   #endif
+}
+
 void JUCE_CALLTYPE FloatVectorOperations::min (float* dest, const float* src, float comp, int num) noexcept
 {
     JUCE_PERFORM_VEC_OP_SRC_DEST (dest[i] = jmin (src[i], comp), Mode::min (s, cmp),
@@ -1244,6 +1314,39 @@ public:
 
         static void doConversionTest (UnitTest&, double*, double*, int*, int) {}
 
+        static void doFloatDoubleConversionTest (UnitTest& u, Random random)
+        {
+            const int num = random.nextInt (500) + 1;
+
+            HeapBlock<float> floats (num + 16), roundTrip (num + 16);
+            HeapBlock<double> doubles (num + 16);
+
+           #if JUCE_ARM
+            float* const f1 = floats;
+            float* const f2 = roundTrip;
+            double* const d1 = doubles;
+           #else
+            float* const f1 = addBytesToPointer (floats.get(), random.nextInt (4) * (int) sizeof (float));
+            float* const f2 = addBytesToPointer (roundTrip.get(), random.nextInt (4) * (int) sizeof (float));
+            double* const d1 = addBytesToPointer (doubles.get(), random.nextInt (2) * (int) sizeof (double));
+           #endif
+
+            for (int i = 0; i < num; ++i)
+                f1[i] = (float) (random.nextDouble() * 2.0 - 1.0);
+
+            FloatVectorOperations::convert (d1, f1, num);
+
+            bool widenedExactly = true;
+
+            for (int i = 0; i < num; ++i)
+                widenedExactly = widenedExactly && (d1[i] == (double) f1[i]);
+
+            u.expect (widenedExactly);
+
+            FloatVectorOperations::convert (f2, d1, num);
+            u.expect (std::equal (f1, f1 + num, f2));
+        }
+
         static void fillRandomly (Random& random, ValueType* d, int num)
         {
             while (--num >= 0)
@@ -1295,6 +1398,11 @@ public:
             TestRunner<float>::runTest (*this, getRandom());
             TestRunner<double>::runTest (*this, getRandom());
         }
+
+        beginTest ("FloatVectorOperations float/double conversion");
+
+        for (int i = 1000; --i >= 0;)
+            TestRunner<float>::doFloatDoubleConversionTest (*this, getRandom());
     }
 };
 
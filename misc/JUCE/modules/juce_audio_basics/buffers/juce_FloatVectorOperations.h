@@ -166,6 +166,12 @@ public:
     /** Converts a stream of integers to floats, multiplying each one by the given multiplier. */
     static void JUCE_CALLTYPE convertFixedToFloat (float* dest, const int* src, float multiplier, int numValues) noexcept;
 
+    /** Converts a vector of floats to doubles. The source and destination must not overlap. */
+    static void JUCE_CALLTYPE convert (double* dest, const float* src, int numValues) noexcept;
+
+    /** Converts a vector of doubles to floats. The source and destination must not overlap. */
+    static void JUCE_CALLTYPE convert (float* dest, const double* src, int numValues) noexcept;
+
     /** Each element of dest will be the minimum of the corresponding element of the source array and the given comp value. */
     static void JUCE_CALLTYPE min (float* dest, const float* src, float comp, int num) noexcept;
 
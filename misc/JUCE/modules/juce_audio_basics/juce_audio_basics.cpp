@@ -37,6 +37,10 @@
 
 #if JUCE_USE_SSE_INTRINSICS
  #include <emmintrin.h>
+
+ #if defined (__AVX__)
+  #include <immintrin.h>
+ #endif
 #endif
 
 #ifndef JUCE_USE_VDSP_FRAMEWORK
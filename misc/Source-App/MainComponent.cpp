@@ -12,6 +12,9 @@
 #include <JuceHeader.h>
 
 #include "C74_GENPLUGIN.h"
+#include "GenBufferArena.h"
+#include "ParameterMirror.h"
+#include "GenParameterTable.h"
 #include "UIComponent.h"
 
 //==============================================================================
@@ -24,21 +27,15 @@ class MainContentComponent   : public AudioAppComponent, Slider::Listener
 public:
     //==============================================================================
     MainContentComponent()
-	:m_CurrentBufferSize(0)
+	:m_GenBuffers(C74_GENPLUGIN::num_inputs(), C74_GENPLUGIN::num_outputs()),
+	 m_ParameterMirror(C74_GENPLUGIN::num_params())
 	{
 		// use a default samplerate and vector size here, reset it later
 		m_C74PluginState = (CommonState *)C74_GENPLUGIN::create(44100, 64);
 		C74_GENPLUGIN::reset(m_C74PluginState);
+		m_ParameterInfo.reset(new GenParameterTable(m_C74PluginState));
 
-		m_InputBuffers = new t_sample *[C74_GENPLUGIN::num_inputs()];
-		m_OutputBuffers = new t_sample *[C74_GENPLUGIN::num_outputs()];
-		
-		for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
-			m_InputBuffers[i] = NULL;
-		}
-		for (int i = 0; i < C74_GENPLUGIN::num_outputs(); i++) {
-			m_OutputBuffers[i] = NULL;
-		}
+		m_GenBuffers.allocate(64);
 		
         // specify the number of input and output channels that we want to open
         setAudioChannels (getNumInputChannels(), getNumOutputChannels());
@@ -76,7 +73,7 @@ public:
 		m_C74PluginState->sr = sampleRate;
 		m_C74PluginState->vs = samplesPerBlockExpected;
 		
-		assureBufferSize(samplesPerBlockExpected);
+		m_GenBuffers.allocate(samplesPerBlockExpected);
     }
 
     void getNextAudioBlock (const AudioSourceChannelInfo& bufferToFill) override
@@ -87,36 +84,18 @@ public:
 		
 		AudioSampleBuffer *buffer = bufferToFill.buffer;
 		
-		assureBufferSize(buffer->getNumSamples());
-		
-		// fill input buffers
-		for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
-			if (i < getNumInputChannels()) {
-				for (int j = 0; j < buffer->getNumSamples(); j++) {
-					m_InputBuffers[i][j] = buffer->getReadPointer(i)[j];
-				}
-			} else {
-				memset(m_InputBuffers[i], 0, m_CurrentBufferSize *  sizeof(double));
-			}
-		}
+		// apply slider changes here, the gen state belongs to the audio thread
+		m_ParameterMirror.drain([this] (int index, t_param value) {
+			C74_GENPLUGIN::setparameter(m_C74PluginState, index, value, NULL);
+		});
 		
-		// process audio
-		C74_GENPLUGIN::perform(m_C74PluginState,
-								  m_InputBuffers,
-								  C74_GENPLUGIN::num_inputs(),
-								  m_OutputBuffers,
-								  C74_GENPLUGIN::num_outputs(),
-								  buffer->getNumSamples());
+		const int numSamples = buffer->getNumSamples();
+		const int maxBlockSize = m_GenBuffers.getMaxBlockSize();
 		
-		// fill output buffers
-		for (int i = 0; i < getNumOutputChannels(); i++) {
-			if (i < C74_GENPLUGIN::num_outputs()) {
-				for (int j = 0; j < buffer->getNumSamples(); j++) {
-					buffer->getWritePointer(i)[j] = m_OutputBuffers[i][j];
-				}
-			} else {
-				buffer->clear (i, 0, buffer->getNumSamples());
-			}
+		// process blocks larger than announced in prepareToPlay in chunks, so
+		// nothing is allocated on the audio thread
+		for (int start = 0; start < numSamples; start += maxBlockSize) {
+			performConverted(*buffer, start, jmin(maxBlockSize, numSamples - start));
 		}
     }
 
@@ -154,16 +133,10 @@ public:
 		if (sliderHolder) {
 			for (long i = 0; i < C74_GENPLUGIN::num_params(); i++) {
 				Slider *slider = new Slider();
-				double min = 0;
-				double max = 1;
-				
-				if (C74_GENPLUGIN::getparameterhasminmax(m_C74PluginState, i)) {
-					min = C74_GENPLUGIN::getparametermin(m_C74PluginState, i);
-					max = C74_GENPLUGIN::getparametermax(m_C74PluginState, i);
-				}
-
 				slider->setSliderStyle(Slider::SliderStyle::LinearHorizontal);
-				slider->setRange(min, max);
+				// c74: a slider needs a range that isn't empty, as the plugin's parameters do
+				const double min = m_ParameterInfo->getMin(i);
+				slider->setRange(min, jmax((double)m_ParameterInfo->getMax(i), min + jmax(std::abs(min), 1.0) * 1.0e-6));
 				slider->setName(String((int)i));
 				slider->addListener(this);
 				
@@ -176,7 +149,7 @@ public:
 		if (sliderLabelHolder) {
 			for (long i = 0; i < C74_GENPLUGIN::num_params(); i++) {
 				Label *sliderLabel = new Label();
-				sliderLabel->setText(String(C74_GENPLUGIN::getparametername(m_C74PluginState, i)), NotificationType::dontSendNotification);
+				sliderLabel->setText(m_ParameterInfo->getName(i), NotificationType::dontSendNotification);
 				sliderLabelHolder->addAndMakeVisible(sliderLabel);
 			}
 		}
@@ -187,28 +160,53 @@ public:
 	void sliderValueChanged (Slider* slider)
 	{
 		long index = atoi(slider->getName().getCharPointer());
-		C74_GENPLUGIN::setparameter(m_C74PluginState, index, slider->getValue(), NULL);
+		m_ParameterMirror.set(index, slider->getValue());
 	}
 	
 
 protected:
 	// c74: since Juce does float sample processing and Gen offers double sample
 	// processing, we need to go through input and output buffers
-	void assureBufferSize(long bufferSize)
+	void performConverted(AudioSampleBuffer& buffer, int startSample, int numSamples)
 	{
-		if (bufferSize > m_CurrentBufferSize) {
-			for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
-				if (m_InputBuffers[i]) delete m_InputBuffers[i];
-				m_InputBuffers[i] = new t_sample[bufferSize];
+		t_sample **inputs = m_GenBuffers.getInputs();
+		t_sample **outputs = m_GenBuffers.getOutputs();
+		
+		// fill input buffers
+		for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
+			if (i < getNumInputChannels()) {
+#ifdef GENLIB_USE_FLOAT32
+				FloatVectorOperations::copy(inputs[i], buffer.getReadPointer(i, startSample), numSamples);
+#else
+				FloatVectorOperations::convert(inputs[i], buffer.getReadPointer(i, startSample), numSamples);
+#endif
+			} else {
+				FloatVectorOperations::clear(inputs[i], numSamples);
 			}
-			for (int i = 0; i < C74_GENPLUGIN::num_outputs(); i++) {
-				if (m_OutputBuffers[i]) delete m_OutputBuffers[i];
-				m_OutputBuffers[i] = new t_sample[bufferSize];
+		}
+		
+		// process audio
+		C74_GENPLUGIN::perform(m_C74PluginState,
+								  inputs,
+								  C74_GENPLUGIN::num_inputs(),
+								  outputs,
+								  C74_GENPLUGIN::num_outputs(),
+								  numSamples);
+		
+		// fill output buffers
+		for (int i = 0; i < getNumOutputChannels(); i++) {
+			if (i < C74_GENPLUGIN::num_outputs()) {
+#ifdef GENLIB_USE_FLOAT32
+				FloatVectorOperations::copy(buffer.getWritePointer(i, startSample), outputs[i], numSamples);
+#else
+				FloatVectorOperations::convert(buffer.getWritePointer(i, startSample), outputs[i], numSamples);
+#endif
+			} else {
+				buffer.clear (i, startSample, numSamples);
 			}
-			
-			m_CurrentBufferSize = bufferSize;
 		}
 	}
+	
 private:
     //==============================================================================
 
@@ -217,10 +215,13 @@ private:
 	UIComponent				*m_uiComponent;
 	
 	CommonState				*m_C74PluginState;
+	std::unique_ptr<GenParameterTable>	m_ParameterInfo;
+	
+	// sized in prepareToPlay, never reallocated on the audio thread
+	GenBufferArena			m_GenBuffers;
 	
-	long					m_CurrentBufferSize;
-	t_sample				**m_InputBuffers;
-	t_sample				**m_OutputBuffers;
+	// slider values on their way to the audio thread
+	ParameterMirror			m_ParameterMirror;
 	
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
@@ -0,0 +1,151 @@
+/*
+  ==============================================================================
+
+    BufferLayoutBenchmark.cpp
+
+    Compares the cost of moving a block through gen-style channel buffers when
+    every channel is its own heap allocation (the old assureBufferSize layout)
+    against the contiguous, cache-aligned GenBufferArena.
+
+    The kernel mimics the access pattern of C74_GENPLUGIN::perform: for every
+    frame, all inputs are read and all outputs are written, so each frame
+    touches one cache line per channel.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "GenBufferArena.h"
+
+#include <iostream>
+
+//==============================================================================
+namespace
+{
+    void convertIn (t_sample** inputs, const AudioSampleBuffer& host, int numInputs, int numSamples)
+    {
+        for (int i = 0; i < numInputs; ++i)
+        {
+           #ifdef GENLIB_USE_FLOAT32
+            FloatVectorOperations::copy (inputs[i], host.getReadPointer (i % host.getNumChannels()), numSamples);
+           #else
+            FloatVectorOperations::convert (inputs[i], host.getReadPointer (i % host.getNumChannels()), numSamples);
+           #endif
+        }
+    }
+
+    void convertOut (AudioSampleBuffer& host, t_sample** outputs, int numOutputs, int numSamples)
+    {
+        for (int i = 0; i < numOutputs; ++i)
+        {
+           #ifdef GENLIB_USE_FLOAT32
+            FloatVectorOperations::copy (host.getWritePointer (i % host.getNumChannels()), outputs[i], numSamples);
+           #else
+            FloatVectorOperations::convert (host.getWritePointer (i % host.getNumChannels()), outputs[i], numSamples);
+           #endif
+        }
+    }
+
+    void performFrames (t_sample** inputs, int numInputs, t_sample** outputs, int numOutputs, int numSamples)
+    {
+        for (int n = 0; n < numSamples; ++n)
+        {
+            t_sample sum = 0;
+
+            for (int i = 0; i < numInputs; ++i)
+                sum += inputs[i][n];
+
+            for (int o = 0; o < numOutputs; ++o)
+                outputs[o][n] = sum * (t_sample) (o + 1);
+        }
+    }
+
+    /** Times numBlocks blocks and returns the nanoseconds spent per sample frame. */
+    double timeBlocks (t_sample** inputs, t_sample** outputs, int numChannels, int blockSize, int numBlocks)
+    {
+        AudioSampleBuffer host (2, blockSize);
+
+        for (int ch = 0; ch < host.getNumChannels(); ++ch)
+            for (int n = 0; n < blockSize; ++n)
+                host.setSample (ch, n, (float) (n % 100) * 0.01f);
+
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            convertIn (inputs, host, numChannels, blockSize);
+            performFrames (inputs, numChannels, outputs, numChannels, blockSize);
+            convertOut (host, outputs, numChannels, blockSize);
+        }
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        return seconds * 1.0e9 / ((double) numBlocks * blockSize);
+    }
+
+    /** The old layout: every channel is an independent new[], with unrelated
+        allocations in between as there would be in a host with other plug-ins.
+    */
+    struct ScatteredChannels
+    {
+        ScatteredChannels (int numChannels, int blockSize, Random& random)
+        {
+            for (int i = 0; i < 2 * numChannels; ++i)
+            {
+                noise.add (new char[(size_t) (1024 + random.nextInt (64 * 1024))]);
+                channels.add (new t_sample[(size_t) blockSize]());
+            }
+        }
+
+        ~ScatteredChannels()
+        {
+            for (auto* c : channels) delete[] c;
+            for (auto* c : noise)    delete[] c;
+        }
+
+        t_sample** getInputs()                      { return channels.getRawDataPointer(); }
+        t_sample** getOutputs()                     { return channels.getRawDataPointer() + channels.size() / 2; }
+
+        Array<t_sample*> channels;
+        Array<char*> noise;
+    };
+}
+
+//==============================================================================
+int main (int, char**)
+{
+    const int channelCounts[] = { 2, 8, 16, 32 };
+    const int blockSizes[]    = { 64, 256, 1024 };
+    const int framesPerRun    = 1 << 22;
+
+    Random random (74);
+
+    std::cout << "channels  block   scattered ns/frame   arena ns/frame   speedup" << std::endl;
+
+    for (auto numChannels : channelCounts)
+    {
+        for (auto blockSize : blockSizes)
+        {
+            const int numBlocks = framesPerRun / blockSize;
+
+            ScatteredChannels scattered (numChannels, blockSize, random);
+            GenBufferArena arena (numChannels, numChannels);
+            arena.allocate (blockSize);
+
+            // warm up both layouts once before measuring
+            timeBlocks (scattered.getInputs(), scattered.getOutputs(), numChannels, blockSize, 16);
+            timeBlocks (arena.getInputs(), arena.getOutputs(), numChannels, blockSize, 16);
+
+            const double scatteredNs = timeBlocks (scattered.getInputs(), scattered.getOutputs(), numChannels, blockSize, numBlocks);
+            const double arenaNs     = timeBlocks (arena.getInputs(), arena.getOutputs(), numChannels, blockSize, numBlocks);
+
+            std::cout << String (numChannels).paddedLeft (' ', 8)
+                      << String (blockSize).paddedLeft (' ', 7)
+                      << String (scatteredNs, 2).paddedLeft (' ', 21)
+                      << String (arenaNs, 2).paddedLeft (' ', 17)
+                      << String (scatteredNs / arenaNs, 2).paddedLeft (' ', 10) << "x" << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,270 @@
+/*
+  ==============================================================================
+
+    PerformBenchmark.cpp
+
+    Times C74_GENPLUGIN::perform of the exported patch block by block, sweeping
+    block sizes from 16 to 4096 samples, sample rates and host channel counts.
+
+    Every block is timed on its own, so besides ns/sample each line shows the
+    median, 99th percentile and worst block, and cycles/sample estimated from
+    the clock rate. The blocks go through the plugin's own processBlock, and
+    its GenLoadMeter splits each one into gen's perform and everything the
+    plugin wraps around it (queued and moved parameters, ramps, sub-blocks and
+    converting the host's channels to and from gen's), which is reported on a
+    line of its own.
+
+        GenPerformBenchmark [--json=results.json]
+
+    The JSON file holds the same lines, for CI to compare runs.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "PluginProcessor.h"
+
+#include <chrono>
+#include <iostream>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+//==============================================================================
+namespace
+{
+    constexpr int samplesPerRun = 1 << 19;
+    constexpr int minBlocksPerRun = 500;
+    constexpr int eventsPerBlock = 2;
+
+    // Time's high resolution ticks are microseconds on some platforms, too
+    // coarse for a block of 16 samples
+    using Clock = std::chrono::steady_clock;
+
+    double secondsBetween (Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double> (end - start).count();
+    }
+
+    struct Timing
+    {
+        double nsPerSample, p50Us, p99Us, maxUs, cyclesPerSample;
+    };
+
+    /** Clock cycles per nanosecond: the time stamp counter's rate where there is
+        one, the reported CPU speed otherwise.
+    */
+    double measureCyclesPerNs()
+    {
+       #if JUCE_INTEL
+        const auto start = Clock::now();
+        const uint64 startCycles = __rdtsc();
+        Thread::sleep (200);
+        const uint64 cycles = __rdtsc() - startCycles;
+        return (double) cycles / (secondsBetween (start, Clock::now()) * 1.0e9);
+       #else
+        return SystemStats::getCpuSpeedInMegahertz() / 1000.0;
+       #endif
+    }
+
+    Timing summarise (Array<double>& blockSeconds, int blockSize, double cyclesPerNs)
+    {
+        std::sort (blockSeconds.begin(), blockSeconds.end());
+
+        double total = 0;
+
+        for (auto seconds : blockSeconds)
+            total += seconds;
+
+        const int numBlocks = blockSeconds.size();
+        const double nsPerSample = total * 1.0e9 / ((double) numBlocks * blockSize);
+
+        return { nsPerSample,
+                 blockSeconds[numBlocks / 2] * 1.0e6,
+                 blockSeconds[jmin (numBlocks - 1, (int) (numBlocks * 0.99))] * 1.0e6,
+                 blockSeconds.getLast() * 1.0e6,
+                 nsPerSample * cyclesPerNs };
+    }
+
+    //==============================================================================
+    /** Host side of the plugin: fills its channels with noise and moves its
+        parameters the way automation does.
+    */
+    struct Host
+    {
+        Host (C74GenAudioProcessor& p, int numHostChannels, int blockSize)
+            : processor (p),
+              parameters (p.AudioProcessor::getParameters()),
+              buffer (numHostChannels, blockSize)
+        {
+        }
+
+        /** The host moves a parameter and queues a few timed changes. */
+        void changeParameters (int block)
+        {
+            if (parameters.isEmpty())
+                return;
+
+            auto* moved = parameters[block % parameters.size()];
+            moved->setValue (jlimit (0.0f, 1.0f, moved->getValue() + (block % 2 == 0 ? 1.0e-6f : -1.0e-6f)));
+
+            for (int e = 0; e < eventsPerBlock; ++e)
+            {
+                const int index = (block + e) % parameters.size();
+                processor.setParameterAtSample (index, parameters[index]->getValue(), 0);
+            }
+        }
+
+        void fillBuffer (Random& random)
+        {
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                for (int n = 0; n < buffer.getNumSamples(); ++n)
+                    buffer.setSample (ch, n, (random.nextFloat() - 0.5f) * 0.2f);
+        }
+
+        C74GenAudioProcessor& processor;
+        const Array<AudioProcessorParameter*>& parameters;
+        AudioBuffer<float> buffer;
+        MidiBuffer midi;
+    };
+
+    //==============================================================================
+    void run (double sampleRate, int blockSize, int numHostChannels, double cyclesPerNs,
+              Timing& perform, Timing& wrapper)
+    {
+        C74GenAudioProcessor processor;
+        processor.setPlayConfigDetails (numHostChannels, numHostChannels, sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+
+        Host host (processor, numHostChannels, blockSize);
+        Random random (74);
+
+        const int numBlocks = jmax (minBlocksPerRun, samplesPerRun / blockSize);
+        Array<double> performSeconds, wrapperSeconds;
+        performSeconds.ensureStorageAllocated (numBlocks);
+        wrapperSeconds.ensureStorageAllocated (numBlocks);
+
+        const int numWarmupBlocks = numBlocks / 10;
+        auto last = processor.getLoadStatistics();
+
+        for (int b = 0; b < numWarmupBlocks + numBlocks; ++b)
+        {
+            host.fillBuffer (random);
+            host.changeParameters (b);
+
+            processor.processBlock (host.buffer, host.midi);
+
+            // the meter times the whole of processBlock, and perform within it
+            const auto stats = processor.getLoadStatistics();
+            const double performTime = stats.stageSeconds[GenLoadMeter::perform] - last.stageSeconds[GenLoadMeter::perform];
+            const double blockTime = stats.totalSeconds - last.totalSeconds;
+            last = stats;
+
+            // the first blocks warm up caches and branch predictors
+            if (b >= numWarmupBlocks)
+            {
+                performSeconds.add (performTime);
+                wrapperSeconds.add (blockTime - performTime);
+            }
+        }
+
+        processor.releaseResources();
+
+        perform = summarise (performSeconds, blockSize, cyclesPerNs);
+        wrapper = summarise (wrapperSeconds, blockSize, cyclesPerNs);
+    }
+
+    var toJson (const char* stage, double sampleRate, int blockSize, int numHostChannels, const Timing& timing)
+    {
+        auto* line = new DynamicObject();
+        line->setProperty ("stage", stage);
+        line->setProperty ("sample_rate", sampleRate);
+        line->setProperty ("block_size", blockSize);
+        line->setProperty ("host_channels", numHostChannels);
+        line->setProperty ("ns_per_sample", timing.nsPerSample);
+        line->setProperty ("p50_us", timing.p50Us);
+        line->setProperty ("p99_us", timing.p99Us);
+        line->setProperty ("max_us", timing.maxUs);
+        line->setProperty ("cycles_per_sample", timing.cyclesPerSample);
+        return line;
+    }
+
+    void print (const char* stage, double sampleRate, int blockSize, int numHostChannels, const Timing& timing)
+    {
+        std::cout << String (stage).paddedRight (' ', 9)
+                  << String ((int) sampleRate).paddedLeft (' ', 7)
+                  << String (blockSize).paddedLeft (' ', 7)
+                  << String (numHostChannels).paddedLeft (' ', 6)
+                  << String (timing.nsPerSample, 2).paddedLeft (' ', 11)
+                  << String (timing.p50Us, 2).paddedLeft (' ', 10)
+                  << String (timing.p99Us, 2).paddedLeft (' ', 10)
+                  << String (timing.maxUs, 2).paddedLeft (' ', 10)
+                  << String (timing.cyclesPerSample, 1).paddedLeft (' ', 14) << std::endl;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const ArgumentList args (argc, argv);
+
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    const int channelCounts[]  = { 1, 2, 8 };
+
+    const double cyclesPerNs = measureCyclesPerNs();
+    Array<var> lines;
+
+    std::cout << "gen patch: " << C74_GENPLUGIN::num_inputs() << " in, " << C74_GENPLUGIN::num_outputs() << " out, "
+              << C74_GENPLUGIN::num_params() << " parameters; " << String (cyclesPerNs, 2) << " cycles/ns" << std::endl << std::endl;
+
+    std::cout << "stage       rate  block  host   ns/sample   p50 us    p99 us    max us  cycles/sample" << std::endl;
+
+    for (auto sampleRate : sampleRates)
+    {
+        for (int blockSize = 16; blockSize <= 4096; blockSize *= 2)
+        {
+            for (auto numHostChannels : channelCounts)
+            {
+                Timing perform, wrapper;
+                run (sampleRate, blockSize, numHostChannels, cyclesPerNs, perform, wrapper);
+
+                print ("perform", sampleRate, blockSize, numHostChannels, perform);
+                print ("wrapper", sampleRate, blockSize, numHostChannels, wrapper);
+
+                lines.add (toJson ("perform", sampleRate, blockSize, numHostChannels, perform));
+                lines.add (toJson ("wrapper", sampleRate, blockSize, numHostChannels, wrapper));
+            }
+        }
+    }
+
+    if (args.containsOption ("--json"))
+    {
+        auto* results = new DynamicObject();
+        results->setProperty ("num_inputs", C74_GENPLUGIN::num_inputs());
+        results->setProperty ("num_outputs", C74_GENPLUGIN::num_outputs());
+        results->setProperty ("num_params", C74_GENPLUGIN::num_params());
+       #ifdef GENLIB_USE_FLOAT32
+        results->setProperty ("float32", true);
+       #else
+        results->setProperty ("float32", false);
+       #endif
+        results->setProperty ("cycles_per_ns", cyclesPerNs);
+        results->setProperty ("results", lines);
+
+        const File file (args.getFileForOption ("--json"));
+
+        if (! file.replaceWithText (JSON::toString (var (results))))
+        {
+            std::cerr << "Can't write " << file.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+  ==============================================================================
+
+    StateSnapshotBenchmark.cpp
+
+    Compares saving a compressed 10 MB gen state from scratch against patching
+    the previous GenStateSnapshot, as happens on every host autosave.
+
+    The state mimics what getstate() produces for a patch with one large Data:
+    its samples as JSON numbers. Between saves, a contiguous part of the Data
+    changes, as if the patch had recorded into it. The new samples either print
+    with as many characters as the old ones, or with a varying number of digits,
+    which moves the rest of the state along.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "GenStateSnapshot.h"
+
+#include <iostream>
+
+//==============================================================================
+namespace
+{
+    constexpr size_t stateSize = 10 * 1024 * 1024;
+    constexpr int numRuns = 10;
+
+    MemoryBlock createState (Random& random)
+    {
+        MemoryOutputStream out (stateSize + 64);
+        out << "{\"data\":[";
+
+        for (int n = 0; out.getDataSize() < stateSize - 32; ++n)
+            out << String (std::sin (n * 0.01) * 0.5 + random.nextDouble() * 0.01, 6) << ",";
+
+        out << "0]}";
+        return out.getMemoryBlock();
+    }
+
+    /** Replaces the samples in a contiguous part of the state. With sameLength,
+        every sample keeps its number of characters; otherwise they vary, and
+        whatever follows the part moves.
+    */
+    void recordInto (MemoryBlock& state, double fraction, bool sameLength, Random& random)
+    {
+        // the header and the last sample stay as they are
+        const size_t length = jmin ((size_t) (fraction * (double) state.getSize()), state.getSize() - 32);
+
+        if (length == 0)
+            return;
+
+        char* data = static_cast<char*> (state.getData());
+        size_t start = 16 + (size_t) random.nextInt (jmax (1, (int) (state.getSize() - length - 32)));
+        size_t end = start + length;
+
+        if (sameLength)
+        {
+            for (size_t i = start; i < end; ++i)
+                if (data[i] >= '0' && data[i] <= '9')
+                    data[i] = (char) ('0' + random.nextInt (10));
+
+            return;
+        }
+
+        // whole samples only, from just after one comma to the next
+        while (data[start] != ',')  ++start;
+        while (data[end] != ',')    ++end;
+
+        MemoryOutputStream edited (state.getSize() + 64);
+        edited.write (data, start + 1);
+
+        for (size_t i = start + 1; i < end; ++i)
+            if (data[i] == ',')
+                edited << String (random.nextDouble() - 0.5, 1 + random.nextInt (7)) << ",";
+
+        edited << String (random.nextDouble() - 0.5, 1 + random.nextInt (7));
+        edited.write (data + end, state.getSize() - end);
+        state = edited.getMemoryBlock();
+    }
+
+    /** One save: gen's getstate(), updating the snapshot and copying it out for the host. */
+    int save (GenStateSnapshot& snapshot, const MemoryBlock& state, MemoryBlock& dest)
+    {
+        memcpy (snapshot.prepare (state.getSize()), state.getData(), state.getSize());
+        const int numEncoded = snapshot.update();
+
+        dest.setSize (snapshot.getEncodedSize(), false);
+        snapshot.writeChunks (static_cast<char*> (dest.getData()));
+        return numEncoded;
+    }
+}
+
+//==============================================================================
+int main (int, char**)
+{
+    const double changedFractions[] = { 0.0, 0.001, 0.01, 0.1, 1.0 };
+
+    Random random (74);
+    MemoryBlock state = createState (random);
+    MemoryBlock dest;
+
+    GenStateSnapshot snapshot;
+    save (snapshot, state, dest);
+
+    std::cout << "state " << (int) (stateSize >> 20) << " MB, compressed to "
+              << String ((double) dest.getSize() / (1 << 20), 2) << " MB in "
+              << (int) snapshot.getNumChunks() << " chunks" << std::endl << std::endl;
+
+    std::cout << "changed   length   full save ms   incremental ms   chunks   speedup" << std::endl;
+
+    for (auto sameLength : { true, false })
+    {
+        for (auto fraction : changedFractions)
+        {
+            double fullSeconds = 0, incrementalSeconds = 0;
+            int numEncoded = 0;
+
+            for (int run = 0; run < numRuns; ++run)
+            {
+                recordInto (state, fraction, sameLength, random);
+
+                // the same state saved both ways, the full save without a usable cache
+                GenStateSnapshot fresh;
+                int64 start = Time::getHighResolutionTicks();
+                save (fresh, state, dest);
+                fullSeconds += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+                start = Time::getHighResolutionTicks();
+                numEncoded += save (snapshot, state, dest);
+                incrementalSeconds += Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+            }
+
+            const double fullMs = fullSeconds * 1000.0 / numRuns;
+            const double incrementalMs = incrementalSeconds * 1000.0 / numRuns;
+
+            std::cout << (String (fraction * 100.0, 1) + "%").paddedLeft (' ', 7)
+                      << String (sameLength ? "same" : "varies").paddedLeft (' ', 9)
+                      << String (fullMs, 2).paddedLeft (' ', 15)
+                      << String (incrementalMs, 2).paddedLeft (' ', 17)
+                      << String (numEncoded / numRuns).paddedLeft (' ', 9)
+                      << String (fullMs / incrementalMs, 1).paddedLeft (' ', 10) << "x" << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    VoiceRenderBenchmark.cpp
+
+    Times GenVoiceEngine rendering the exported patch with every voice held,
+    sweeping the number of voices and of worker threads, at a 64 sample block.
+
+    Each line shows the time one block takes on average and at worst, and how
+    much of the block's real-time budget that is. Above 100% the audio thread
+    can't keep up.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "GenVoiceEngine.h"
+
+#include <iostream>
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 64;
+    constexpr int numWarmupBlocks = 200;
+    constexpr int numBlocks = 4000;
+
+    struct BlockTiming
+    {
+        double averageMs, worstMs;
+    };
+
+    BlockTiming timeVoices (const GenParameterTable& info, int numVoices, int numThreads)
+    {
+        GenVoiceEngine engine (info, numVoices, numThreads, false);
+        engine.prepare (sampleRate, blockSize);
+
+        AudioBuffer<float> buffer (jmax (1, C74_GENPLUGIN::num_outputs()), blockSize);
+        MidiBuffer midi;
+
+        for (int v = 0; v < numVoices; ++v)
+            midi.addEvent (MidiMessage::noteOn (1, 36 + v % 72, (uint8) 100), 0);
+
+        engine.render (buffer, midi, 0, blockSize);
+        midi.clear();
+
+        for (int b = 0; b < numWarmupBlocks; ++b)
+            engine.render (buffer, midi, 0, blockSize);
+
+        double totalSeconds = 0, worstSeconds = 0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            const int64 start = Time::getHighResolutionTicks();
+            engine.render (buffer, midi, 0, blockSize);
+            const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+            totalSeconds += seconds;
+            worstSeconds = jmax (worstSeconds, seconds);
+        }
+
+        return { totalSeconds * 1000.0 / numBlocks, worstSeconds * 1000.0 };
+    }
+}
+
+//==============================================================================
+int main (int, char**)
+{
+    const int voiceCounts[] = { 1, 8, 16, 32, 64 };
+    const int maxThreads = jlimit (0, 7, SystemStats::getNumCpus() - 1);
+    const double budgetMs = blockSize * 1000.0 / sampleRate;
+
+    auto* state = (CommonState*) C74_GENPLUGIN::create (sampleRate, blockSize);
+    GenParameterTable info (state);
+
+    std::cout << "block " << blockSize << " samples at " << (int) sampleRate << " Hz, budget "
+              << String (budgetMs, 3) << " ms, " << SystemStats::getNumCpus() << " cpus" << std::endl << std::endl;
+
+    std::cout << "voices   threads   average ms   worst ms   budget   speedup" << std::endl;
+
+    for (auto numVoices : voiceCounts)
+    {
+        double singleThreadedMs = 0;
+
+        for (int numThreads = 0; numThreads <= jmin (maxThreads, numVoices - 1); ++numThreads)
+        {
+            const BlockTiming timing = timeVoices (info, numVoices, numThreads);
+
+            if (numThreads == 0)
+                singleThreadedMs = timing.averageMs;
+
+            std::cout << String (numVoices).paddedLeft (' ', 6)
+                      << String (numThreads).paddedLeft (' ', 10)
+                      << String (timing.averageMs, 4).paddedLeft (' ', 13)
+                      << String (timing.worstMs, 4).paddedLeft (' ', 11)
+                      << (String (timing.averageMs * 100.0 / budgetMs, 1) + "%").paddedLeft (' ', 9)
+                      << String (singleThreadedMs / timing.averageMs, 2).paddedLeft (' ', 9) << "x" << std::endl;
+        }
+    }
+
+    C74_GENPLUGIN::destroy (state);
+    return 0;
+}
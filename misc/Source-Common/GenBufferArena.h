@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    GenBufferArena.h
+
+    Owns the t_sample channels that are handed to C74_GENPLUGIN::perform.
+
+  ==============================================================================
+*/
+
+#ifndef GENBUFFERARENA_H_INCLUDED
+#define GENBUFFERARENA_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+
+//==============================================================================
+/**
+    All gen input and output channels live back to back in one aligned block,
+    sized for the largest block the host has announced. allocate() is the only
+    method that touches the heap, so it must be called from prepareToPlay (or
+    similar) and never from the audio thread.
+*/
+class GenBufferArena
+{
+public:
+    //==============================================================================
+    GenBufferArena (int numInputs, int numOutputs)
+        : m_NumInputs (numInputs), m_NumOutputs (numOutputs), m_MaxBlockSize (0)
+    {
+        m_Channels.calloc (jmax (1, m_NumInputs + m_NumOutputs));
+    }
+
+    /** (Re)allocates room for maxBlockSize samples on every channel and clears it.
+        Does nothing if the arena is already big enough.
+    */
+    void allocate (int maxBlockSize)
+    {
+        jassert (maxBlockSize > 0);
+
+        if (maxBlockSize <= m_MaxBlockSize)
+            return;
+
+        // pad every channel to a whole, odd number of cache lines: each channel starts
+        // aligned, and channels don't all map onto the same cache sets when the block
+        // size is a power of two (gen touches every channel once per frame)
+        const size_t samplesPerLine = alignment / sizeof (t_sample);
+        size_t linesPerChannel = ((size_t) maxBlockSize + samplesPerLine - 1) / samplesPerLine;
+
+        if ((linesPerChannel & 1) == 0)
+            ++linesPerChannel;
+
+        const size_t stride = linesPerChannel * samplesPerLine;
+        const size_t numChannels = (size_t) (m_NumInputs + m_NumOutputs);
+
+        m_Memory.calloc (stride * numChannels * sizeof (t_sample) + alignment);
+
+        auto* first = reinterpret_cast<t_sample*> ((reinterpret_cast<pointer_sized_int> (m_Memory.get()) + alignment - 1)
+                                                    & ~(pointer_sized_int) (alignment - 1));
+
+        for (size_t i = 0; i < numChannels; ++i)
+            m_Channels[i] = first + i * stride;
+
+        m_MaxBlockSize = maxBlockSize;
+    }
+
+    /** The number of samples each channel can hold. */
+    int getMaxBlockSize() const noexcept     { return m_MaxBlockSize; }
+
+    /** The gen input channels, as passed to C74_GENPLUGIN::perform. */
+    t_sample** getInputs() noexcept          { return m_Channels.get(); }
+
+    /** The gen output channels, as passed to C74_GENPLUGIN::perform. */
+    t_sample** getOutputs() noexcept         { return m_Channels.get() + m_NumInputs; }
+
+    /** The byte alignment of each channel. */
+    static constexpr size_t alignment = 64;
+
+private:
+    //==============================================================================
+    const int m_NumInputs, m_NumOutputs;
+    int m_MaxBlockSize;
+
+    HeapBlock<char> m_Memory;
+    HeapBlock<t_sample*> m_Channels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenBufferArena)
+};
+
+
+#endif  // GENBUFFERARENA_H_INCLUDED
@@ -0,0 +1,236 @@
+/*
+  ==============================================================================
+
+    GenLoadMeter.h
+
+    Measures how much of each block's deadline processBlock takes.
+
+  ==============================================================================
+*/
+
+#ifndef GENLOADMETER_H_INCLUDED
+#define GENLOADMETER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <chrono>
+
+// set by GEN_LOAD_OVERLAY, which gives the plugin an editor showing the load
+#ifndef C74_LOAD_OVERLAY
+ #define C74_LOAD_OVERLAY 0
+#endif
+
+//==============================================================================
+/**
+    Times every block the audio thread processes against its deadline, the
+    block's length in real time, so one instance eating the budget stands out
+    among hundreds.
+
+    An AudioProcessLoadMeasurer keeps the smoothed load. On top of it, blocks
+    are counted in a histogram by the proportion of the deadline they took,
+    blocks above atRiskProportion are counted as at risk of an xrun and blocks
+    over it as overruns. Within a block, lap() splits the time between
+    converting the host's channels for gen and gen's perform(); anything else
+    (parameters, MIDI, streams) is the rest.
+
+    The audio thread only stores to atomics, so getStatistics() can be called
+    from any thread while it runs. The numbers it returns aren't a consistent
+    snapshot, which doesn't matter for showing them.
+*/
+class GenLoadMeter
+{
+public:
+    //==============================================================================
+    enum Stage
+    {
+        conversion, perform,
+        numStages
+    };
+
+    // bins are 5% of the deadline wide; the last one counts the overruns
+    static constexpr int numBins = 21;
+    static constexpr double atRiskProportion = 0.8;
+
+    struct Statistics
+    {
+        double load = 0;                    // smoothed proportion of the deadline
+        double worstBlock = 0;              // longest block as a proportion of its deadline
+        int64 numBlocks = 0;
+        int64 numBlocksAtRisk = 0;          // took more than atRiskProportion of the deadline
+        int64 numOverruns = 0;              // took longer than the deadline
+        int64 histogram[numBins] = {};      // bin b holds blocks from b * 5% of the deadline
+        double stageSeconds[numStages] = {};
+        double totalSeconds = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    //==============================================================================
+    GenLoadMeter()
+    {
+        resetCounters();
+    }
+
+    /** Call from prepareToPlay. */
+    void prepare (double sampleRate, int maximumBlockSize)
+    {
+        m_SampleRate = sampleRate;
+        m_MaximumBlockSize = maximumBlockSize;
+        m_MsPerMaximumBlock = maximumBlockSize * 1000.0 / sampleRate;
+        m_Measurer.reset (sampleRate, maximumBlockSize);
+        m_ResetPending = true;
+    }
+
+    //==============================================================================
+    /** Times the block numSamples long that is processed during its lifetime. */
+    class BlockTimer
+    {
+    public:
+        BlockTimer (GenLoadMeter& meter, int numSamples) noexcept
+            : m_Meter (meter), m_NumSamples (numSamples), m_Start (Clock::now())
+        {
+            m_Meter.beginBlock();
+        }
+
+        ~BlockTimer()
+        {
+            m_Meter.endBlock (m_Start, m_NumSamples);
+        }
+
+    private:
+        GenLoadMeter& m_Meter;
+        const int m_NumSamples;
+        const Clock::time_point m_Start;
+
+        JUCE_DECLARE_NON_COPYABLE (BlockTimer)
+    };
+
+    /** Audio thread: adds the time since lapStart to stage and returns the time
+        now, for the next lap to start from.
+    */
+    Clock::time_point lap (Stage stage, Clock::time_point lapStart) noexcept
+    {
+        const auto now = Clock::now();
+        m_BlockStageTime[stage] += now - lapStart;
+        return now;
+    }
+
+    //==============================================================================
+    /** Any thread. */
+    Statistics getStatistics() const
+    {
+        Statistics stats;
+        stats.load = m_Load.load (std::memory_order_relaxed);
+        stats.worstBlock = m_WorstBlock.load (std::memory_order_relaxed);
+        stats.numBlocks = m_NumBlocks.load (std::memory_order_relaxed);
+        stats.numBlocksAtRisk = m_NumBlocksAtRisk.load (std::memory_order_relaxed);
+        stats.numOverruns = m_NumOverruns.load (std::memory_order_relaxed);
+
+        for (int b = 0; b < numBins; ++b)
+            stats.histogram[b] = m_Histogram[b].load (std::memory_order_relaxed);
+
+        for (int s = 0; s < numStages; ++s)
+            stats.stageSeconds[s] = m_StageNanoseconds[s].load (std::memory_order_relaxed) * 1.0e-9;
+
+        stats.totalSeconds = m_TotalNanoseconds.load (std::memory_order_relaxed) * 1.0e-9;
+        return stats;
+    }
+
+    /** Any thread: starts counting again from the next block. */
+    void resetStatistics() noexcept
+    {
+        m_ResetPending = true;
+    }
+
+private:
+    //==============================================================================
+    void beginBlock() noexcept
+    {
+        // the audio thread does the resetting, so the counters only ever have one writer
+        if (m_ResetPending.exchange (false))
+        {
+            m_Measurer.reset (m_SampleRate, m_MaximumBlockSize);
+            resetCounters();
+        }
+
+        for (auto& time : m_BlockStageTime)
+            time = Clock::duration::zero();
+    }
+
+    void endBlock (Clock::time_point start, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        const auto elapsed = Clock::now() - start;
+        const double seconds = std::chrono::duration<double> (elapsed).count();
+        const double proportion = seconds * m_SampleRate / numSamples;
+
+        // the measurer holds every block to the deadline of the largest, so
+        // shorter ones are scaled up to it
+        m_Measurer.registerBlockRenderTime (proportion * m_MsPerMaximumBlock);
+        m_Load.store (m_Measurer.getLoadAsProportion(), std::memory_order_relaxed);
+
+        const int bin = jmin (numBins - 1, (int) (proportion * (numBins - 1)));
+        add (m_Histogram[bin], 1);
+        add (m_NumBlocks, 1);
+
+        if (proportion > atRiskProportion)
+            add (m_NumBlocksAtRisk, 1);
+
+        if (proportion > 1.0)
+            add (m_NumOverruns, 1);
+
+        if (proportion > m_WorstBlock.load (std::memory_order_relaxed))
+            m_WorstBlock.store (proportion, std::memory_order_relaxed);
+
+        for (int s = 0; s < numStages; ++s)
+            add (m_StageNanoseconds[s], std::chrono::duration_cast<std::chrono::nanoseconds> (m_BlockStageTime[s]).count());
+
+        add (m_TotalNanoseconds, std::chrono::duration_cast<std::chrono::nanoseconds> (elapsed).count());
+    }
+
+    // only the audio thread writes, so a relaxed load and store will do
+    static void add (std::atomic<int64>& counter, int64 amount) noexcept
+    {
+        counter.store (counter.load (std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void resetCounters() noexcept
+    {
+        m_Load = 0;
+        m_WorstBlock = 0;
+        m_NumBlocks = 0;
+        m_NumBlocksAtRisk = 0;
+        m_NumOverruns = 0;
+        m_TotalNanoseconds = 0;
+
+        for (auto& bin : m_Histogram)
+            bin = 0;
+
+        for (auto& nanoseconds : m_StageNanoseconds)
+            nanoseconds = 0;
+    }
+
+    //==============================================================================
+    // audio thread only
+    AudioProcessLoadMeasurer m_Measurer;
+    double m_SampleRate = 44100;
+    int m_MaximumBlockSize = 512;
+    double m_MsPerMaximumBlock = 512 * 1000.0 / 44100;
+    Clock::duration m_BlockStageTime[numStages] = {};
+
+    // written by the audio thread, read by any
+    std::atomic<double> m_Load, m_WorstBlock;
+    std::atomic<int64> m_NumBlocks, m_NumBlocksAtRisk, m_NumOverruns, m_TotalNanoseconds;
+    std::atomic<int64> m_Histogram[numBins];
+    std::atomic<int64> m_StageNanoseconds[numStages];
+
+    std::atomic<bool> m_ResetPending { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenLoadMeter)
+};
+
+
+#endif  // GENLOADMETER_H_INCLUDED
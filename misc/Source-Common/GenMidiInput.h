@@ -0,0 +1,303 @@
+/*
+  ==============================================================================
+
+    GenMidiInput.h
+
+    Turns incoming MIDI into gen parameter changes and inlet signals.
+
+  ==============================================================================
+*/
+
+#ifndef GENMIDIINPUT_H_INCLUDED
+#define GENMIDIINPUT_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+#include "GenParameterTable.h"
+#include "GenPluginMetadata.h"
+
+#include <limits>
+
+// set by GEN_MIDI_INPUT (or GEN_SYNTH), which also makes the plugin ask for MIDI
+#ifndef C74_MIDI_INPUT
+ #define C74_MIDI_INPUT 0
+#endif
+
+//==============================================================================
+/**
+    Maps note, velocity, gate, pitch bend, pressure, MPE timbre and controllers
+    onto gen parameters or signal inlets, as set in the "midi" object of the plugin
+    metadata (see GenPluginMetadata):
+
+        { "midi": { "note": "pitch", "gate": "in3", "pitchbend_range": 12,
+                    "cc": { "74": "cutoff" } } }
+
+    A target is either the name of a gen parameter or "inN" for gen's signal
+    inlet N, which then carries the value instead of host audio. Without a "midi"
+    object, parameters called note, velocity, gate, pitchbend, pressure and
+    timbre are mapped to the source of the same name.
+
+    Note numbers and pitch bend (in semitones) are passed on as they are;
+    velocity, gate, pressure, timbre and controllers run from 0 to 1, which
+    parameters receive scaled to their range.
+*/
+class GenMidiMapping
+{
+public:
+    //==============================================================================
+    enum Source
+    {
+        note, velocity, gate, pitchbend, pressure, timbre,
+        numNamedSources,
+        firstController = numNamedSources,
+        numSources = firstController + 128
+    };
+
+    //==============================================================================
+    GenMidiMapping (const GenParameterTable& parameterInfo, int numInlets)
+        : m_Info (parameterInfo),
+          m_NumInlets (numInlets)
+    {
+        m_DrivesInlet.calloc (jmax (1, numInlets));
+        m_DrivesParameter.calloc (jmax (1, parameterInfo.size()));
+
+        if (! C74_MIDI_INPUT)
+            return;
+
+        const var& midi = GenPluginMetadata::get()["midi"];
+        const char* sourceNames[] = { "note", "velocity", "gate", "pitchbend", "pressure", "timbre" };
+
+        for (int source = 0; source < numNamedSources; ++source)
+        {
+            const String name (sourceNames[source]);
+            setTarget (source, midi.isObject() ? midi[Identifier (name)].toString() : name, source != note && source != pitchbend);
+        }
+
+        if (auto* controllers = midi["cc"].getDynamicObject())
+            for (auto& property : controllers->getProperties())
+                if (isPositiveAndBelow (property.name.toString().getIntValue(), 128))
+                    setTarget (firstController + property.name.toString().getIntValue(), property.value.toString(), true);
+
+        m_PitchBendRange = midi.isObject() ? (double) midi.getProperty ("pitchbend_range", 2.0) : 2.0;
+    }
+
+    /** True if MIDI input is built in and anything is mapped. */
+    bool isEnabled() const noexcept                     { return m_NumTargets > 0; }
+
+    /** True if inlet index (from 0) carries a MIDI value rather than host audio. */
+    bool drivesInlet (int index) const noexcept         { return m_DrivesInlet[index]; }
+
+    /** True if parameter index is set from MIDI rather than by the host. */
+    bool drivesParameter (int index) const noexcept     { return m_DrivesParameter[index]; }
+
+    /** True if source (a Source, or firstController plus a controller number) goes anywhere. */
+    bool isMapped (int source) const noexcept           { return m_Targets[source].parameter >= 0 || m_Targets[source].inlet >= 0; }
+
+    int getNumInlets() const noexcept                   { return m_NumInlets; }
+
+    /** Semitones of pitch bend at either end of the wheel. */
+    double getPitchBendRange() const noexcept           { return m_PitchBendRange; }
+
+    /** Passes a source's value on to setParameter (int index, t_param value) or
+        setInlet (int index, t_sample value), whichever it's mapped to.
+    */
+    template <typename SetParameter, typename SetInlet>
+    void send (int source, double value, SetParameter&& setParameter, SetInlet&& setInlet) const noexcept
+    {
+        const Target& target = m_Targets[source];
+
+        if (target.inlet >= 0)
+            setInlet (target.inlet, (t_sample) value);
+        else if (target.parameter >= 0)
+            setParameter (target.parameter, target.scaled ? m_Info.denormalise (target.parameter, (t_param) value) : (t_param) value);
+    }
+
+private:
+    //==============================================================================
+    struct Target
+    {
+        int parameter = -1, inlet = -1;
+        bool scaled = false;
+    };
+
+    void setTarget (int source, const String& name, bool scaled)
+    {
+        Target target;
+        target.inlet = GenPluginMetadata::getInletIndex (name, m_NumInlets);
+
+        if (target.inlet >= 0)
+            m_DrivesInlet[target.inlet] = true;
+
+        for (int i = 0; i < m_Info.size() && target.inlet < 0; ++i)
+            if (name.isNotEmpty() && m_Info.getName (i) == name)
+                target.parameter = i;
+
+        if (target.parameter >= 0)
+            m_DrivesParameter[target.parameter] = true;
+
+        target.scaled = scaled;
+        m_Targets[source] = target;
+
+        if (target.parameter >= 0 || target.inlet >= 0)
+            ++m_NumTargets;
+    }
+
+    //==============================================================================
+    const GenParameterTable& m_Info;
+    const int m_NumInlets;
+
+    Target m_Targets[numSources];
+    int m_NumTargets = 0;
+    double m_PitchBendRange = 2.0;
+
+    HeapBlock<bool> m_DrivesInlet, m_DrivesParameter;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenMidiMapping)
+};
+
+//==============================================================================
+/**
+    Feeds a single gen instance from MIDI through a GenMidiMapping. Notes are
+    monophonic with last-note priority, so releasing a note falls back to the
+    one held before it.
+
+    Everything after the constructor runs on the audio thread and never
+    allocates. The processor walks a block's events with applyEventsBefore(),
+    splitting gen's perform where they fall.
+*/
+class GenMidiInput
+{
+public:
+    //==============================================================================
+    GenMidiInput (const GenParameterTable& parameterInfo, int numInlets)
+        : m_Mapping (parameterInfo, numInlets)
+    {
+        m_InletValues.calloc (jmax (1, numInlets));
+    }
+
+    /** True if MIDI input is built in and anything is mapped. */
+    bool isEnabled() const noexcept                     { return m_Mapping.isEnabled(); }
+
+    /** True if inlet index (from 0) carries a MIDI value rather than host audio. */
+    bool drivesInlet (int index) const noexcept         { return m_Mapping.drivesInlet (index); }
+
+    /** The value a MIDI driven inlet currently carries. */
+    t_sample getInletValue (int index) const noexcept   { return m_InletValues[index]; }
+
+    //==============================================================================
+    /** Audio thread: starts on the events of a new block. The buffer must stay
+        alive until the block is processed.
+    */
+    void beginBlock (const MidiBuffer& midiMessages) noexcept
+    {
+        m_NextEvent = midiMessages.cbegin();
+        m_EndEvent = midiMessages.cend();
+    }
+
+    /** Audio thread: handles the events before sampleOffset, passing parameter
+        changes to setParameter (int index, t_param value). Returns the position
+        of the next event, or INT_MAX if there is none in this block.
+    */
+    template <typename SetParameter>
+    int applyEventsBefore (int sampleOffset, SetParameter&& setParameter) noexcept
+    {
+        for (; m_NextEvent != m_EndEvent; ++m_NextEvent)
+        {
+            const auto event = *m_NextEvent;
+
+            if (event.samplePosition >= sampleOffset)
+                return event.samplePosition;
+
+            handleEvent (event.data, event.numBytes, setParameter);
+        }
+
+        return std::numeric_limits<int>::max();
+    }
+
+private:
+    //==============================================================================
+    template <typename SetParameter>
+    void send (int source, double value, SetParameter& setParameter) noexcept
+    {
+        m_Mapping.send (source, value, setParameter,
+                        [this] (int inlet, t_sample inletValue) { m_InletValues[inlet] = inletValue; });
+    }
+
+    template <typename SetParameter>
+    void handleEvent (const uint8* data, int numBytes, SetParameter& setParameter) noexcept
+    {
+        if (numBytes < 2)
+            return;
+
+        const int status = data[0] & 0xf0;
+        const int data1 = data[1] & 0x7f;
+        const int data2 = numBytes > 2 ? (data[2] & 0x7f) : 0;
+
+        if (status == 0x90 && data2 > 0)
+        {
+            releaseNote (data1);
+            m_HeldNotes[m_NumHeldNotes++] = (uint8) data1;
+
+            send (GenMidiMapping::note, data1, setParameter);
+            send (GenMidiMapping::velocity, data2 / 127.0, setParameter);
+            send (GenMidiMapping::gate, 1.0, setParameter);
+        }
+        else if (status == 0x80 || status == 0x90)
+        {
+            const bool wasSounding = m_NumHeldNotes > 0 && m_HeldNotes[m_NumHeldNotes - 1] == data1;
+            releaseNote (data1);
+
+            if (wasSounding && m_NumHeldNotes > 0)
+                send (GenMidiMapping::note, m_HeldNotes[m_NumHeldNotes - 1], setParameter);
+            else if (m_NumHeldNotes == 0)
+                send (GenMidiMapping::gate, 0.0, setParameter);
+        }
+        else if (status == 0xb0)
+        {
+            // all notes off and all sound off also close the gate
+            if (data1 == 120 || data1 == 123)
+            {
+                m_NumHeldNotes = 0;
+                send (GenMidiMapping::gate, 0.0, setParameter);
+            }
+
+            send (GenMidiMapping::firstController + data1, data2 / 127.0, setParameter);
+        }
+        else if (status == 0xe0 && numBytes > 2)
+        {
+            send (GenMidiMapping::pitchbend, (((data2 << 7) | data1) - 8192) / 8192.0 * m_Mapping.getPitchBendRange(), setParameter);
+        }
+        else if (status == 0xd0)
+        {
+            send (GenMidiMapping::pressure, data1 / 127.0, setParameter);
+        }
+    }
+
+    void releaseNote (int noteNumber) noexcept
+    {
+        for (int i = 0; i < m_NumHeldNotes; ++i)
+        {
+            if (m_HeldNotes[i] == noteNumber)
+            {
+                memmove (m_HeldNotes + i, m_HeldNotes + i + 1, (size_t) (m_NumHeldNotes - i - 1));
+                --m_NumHeldNotes;
+                return;
+            }
+        }
+    }
+
+    //==============================================================================
+    GenMidiMapping m_Mapping;
+    HeapBlock<t_sample> m_InletValues;
+
+    // audio thread only
+    MidiBufferIterator m_NextEvent, m_EndEvent;
+    uint8 m_HeldNotes[128] = {};
+    int m_NumHeldNotes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenMidiInput)
+};
+
+
+#endif  // GENMIDIINPUT_H_INCLUDED
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    GenParameterTable.h
+
+    Parameter metadata read from gen once, instead of on every query.
+
+  ==============================================================================
+*/
+
+#ifndef GENPARAMETERTABLE_H_INCLUDED
+#define GENPARAMETERTABLE_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+
+//==============================================================================
+/**
+    Name, units and range of every gen parameter, stored as one array per
+    field. None of this changes after the exported code is compiled, so it is
+    read from gen once and every lookup afterwards is a plain array access.
+
+    Parameters without a min/max in gen get a 0..1 range.
+*/
+class GenParameterTable
+{
+public:
+    //==============================================================================
+    explicit GenParameterTable (CommonState* state)
+        : m_NumParams (C74_GENPLUGIN::num_params())
+    {
+        const int numSlots = jmax (1, m_NumParams);
+        m_Min.malloc (numSlots);
+        m_Max.malloc (numSlots);
+        m_Range.malloc (numSlots);
+        m_InverseRange.malloc (numSlots);
+        m_HasMinMax.malloc (numSlots);
+
+        for (int i = 0; i < m_NumParams; ++i)
+        {
+            m_Names.add (String (C74_GENPLUGIN::getparametername (state, i)));
+            m_Units.add (String (C74_GENPLUGIN::getparameterunits (state, i)));
+            m_HasMinMax[i] = C74_GENPLUGIN::getparameterhasminmax (state, i) != 0;
+
+            m_Min[i] = m_HasMinMax[i] ? C74_GENPLUGIN::getparametermin (state, i) : 0;
+            m_Max[i] = m_HasMinMax[i] ? C74_GENPLUGIN::getparametermax (state, i) : 1;
+            m_Range[i] = std::abs (m_Max[i] - m_Min[i]);
+            m_InverseRange[i] = m_Range[i] > 0 ? 1 / m_Range[i] : 0;
+        }
+    }
+
+    //==============================================================================
+    int size() const noexcept                               { return m_NumParams; }
+
+    const String& getName (int index) const noexcept        { return m_Names.getReference (index); }
+    const String& getUnits (int index) const noexcept       { return m_Units.getReference (index); }
+    bool hasMinMax (int index) const noexcept               { return m_HasMinMax[index]; }
+
+    t_param getMin (int index) const noexcept               { return m_Min[index]; }
+    t_param getMax (int index) const noexcept               { return m_Max[index]; }
+    t_param getRange (int index) const noexcept             { return m_Range[index]; }
+
+    /** Maps a gen value into 0..1. */
+    t_param normalise (int index, t_param value) const noexcept
+    {
+        return (value - m_Min[index]) * m_InverseRange[index];
+    }
+
+    /** Maps a 0..1 value into the gen parameter's range. */
+    t_param denormalise (int index, t_param normalisedValue) const noexcept
+    {
+        return m_Min[index] + normalisedValue * m_Range[index];
+    }
+
+private:
+    //==============================================================================
+    const int m_NumParams;
+
+    HeapBlock<t_param> m_Min, m_Max, m_Range, m_InverseRange;
+    HeapBlock<bool> m_HasMinMax;
+    StringArray m_Names, m_Units;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenParameterTable)
+};
+
+
+#endif  // GENPARAMETERTABLE_H_INCLUDED
@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    GenPluginMetadata.h
+
+    Optional per-export settings that gen's exported code doesn't carry.
+
+  ==============================================================================
+*/
+
+#ifndef GENPLUGINMETADATA_H_INCLUDED
+#define GENPLUGINMETADATA_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#if C74_HAS_PLUGIN_METADATA
+ #include "GenMetadataData.h"
+#endif
+
+// default smoothing ramp for every gen parameter, set with GEN_PARAMETER_RAMP_MS
+#ifndef C74_PARAMETER_RAMP_MS
+ #define C74_PARAMETER_RAMP_MS 0
+#endif
+
+// tail after which silent input skips gen, set with GEN_SILENCE_TAIL_MS; negative never skips
+#ifndef C74_SILENCE_TAIL_MS
+ #define C74_SILENCE_TAIL_MS -1
+#endif
+
+//==============================================================================
+/**
+    The JSON file given to CMake as GEN_PLUGIN_METADATA is compiled into the
+    binary and read from here. Values for a single gen parameter live in the
+    "parameters" object under the parameter's name, e.g.
+
+        { "parameters": { "cutoff": { "ramp_ms": 30 } } }
+
+    Settings for the whole plugin sit at the top level, e.g. "silence_tail_ms".
+*/
+namespace GenPluginMetadata
+{
+    /** The parsed metadata, or a void var if none was built in. */
+    inline const var& get()
+    {
+        static const var metadata = []
+        {
+           #if C74_HAS_PLUGIN_METADATA
+            int size = 0;
+
+            if (auto* data = GenMetadataData::getNamedResource (GenMetadataData::namedResourceList[0], size))
+                return JSON::parse (String::fromUTF8 (data, size));
+           #endif
+
+            return var();
+        }();
+
+        return metadata;
+    }
+
+    /** Looks up a property of one gen parameter, returning defaultValue if it isn't set. */
+    inline var getParameterProperty (const String& parameterName, const Identifier& property, const var& defaultValue)
+    {
+        if (parameterName.isEmpty())
+            return defaultValue;
+
+        const var& value = get()["parameters"][Identifier (parameterName)][property];
+        return value.isVoid() ? defaultValue : value;
+    }
+
+    /** The smoothing ramp of a gen parameter in milliseconds, 0 if it isn't smoothed. */
+    inline double getParameterRampMs (const String& parameterName)
+    {
+        return jmax (0.0, (double) getParameterProperty (parameterName, "ramp_ms", C74_PARAMETER_RAMP_MS));
+    }
+
+    /** How long the patch keeps sounding after its input falls silent, in
+        milliseconds, or a negative value if it may never be skipped.
+    */
+    inline double getSilenceTailMs()
+    {
+        return (double) get().getProperty ("silence_tail_ms", C74_SILENCE_TAIL_MS);
+    }
+
+    /** The index (from 0) of a signal inlet named as in gen, "in1", "in2", ...,
+        or -1 if name isn't one of the patch's numInlets inlets.
+    */
+    inline int getInletIndex (const String& name, int numInlets)
+    {
+        if (! name.startsWith ("in") || ! name.substring (2).containsOnly ("0123456789"))
+            return -1;
+
+        // gen numbers its inlets from 1
+        const int inlet = name.substring (2).getIntValue() - 1;
+        return isPositiveAndBelow (inlet, numInlets) ? inlet : -1;
+    }
+
+    /** The inlet "stream_position" names, which carries the streamed buffers'
+        playhead, or -1 if there is none.
+    */
+    inline int getStreamPositionInlet (int numInlets)
+    {
+        return getInletIndex (get()["stream_position"].toString(), numInlets);
+    }
+}
+
+
+#endif  // GENPLUGINMETADATA_H_INCLUDED
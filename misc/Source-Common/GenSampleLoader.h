@@ -0,0 +1,399 @@
+/*
+  ==============================================================================
+
+    GenSampleLoader.h
+
+    Fills gen buffer~/Data references from audio files in the background.
+
+  ==============================================================================
+*/
+
+#ifndef GENSAMPLELOADER_H_INCLUDED
+#define GENSAMPLELOADER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+#include "GenSamplePool.h"
+#include "GenStreamingBuffer.h"
+
+#include <atomic>
+
+//==============================================================================
+/**
+    The samples of one audio file in the layout gen's Data uses: frames one
+    after another, with the channels of a frame interleaved.
+
+    gen is handed getReference(), which points at the genlib data info
+    describing the samples, as the reference argument of setparameter().
+    The samples are either owned, shared through GenSamplePool or the window
+    of a GenStreamingBuffer.
+*/
+struct GenSampleData
+{
+    t_genlib_data_info info;    // keep first, it is what the reference points at
+    HeapBlock<t_sample> samples;
+    GenSamplePool::Entry::Ptr pooledSamples;
+    std::unique_ptr<GenStreamingBuffer> stream;
+    double sampleRate = 0;
+    File file;
+
+    void* getReference() noexcept       { return &info; }
+
+    JUCE_LEAK_DETECTOR (GenSampleData)
+};
+
+//==============================================================================
+/**
+    Reads WAV, AIFF and FLAC files into GenSampleData on a background thread
+    and hands them to the audio thread, which binds them to gen's buffer
+    parameters between two blocks:
+
+        any thread:      load (index, file)
+        loader thread:   read the file ... publish
+        audio thread:    bindPending(), setparameter (index, ref), retire (old)
+        loader thread:   delete (old)
+
+    WAV and AIFF files are memory mapped, so reading them costs little more
+    than the conversion into gen's sample format. Files loaded as shared come
+    from the process-wide GenSamplePool instead of being copied per instance.
+    Streamed files are read into a GenStreamingBuffer's window as they play.
+    The audio thread calls are wait-free and never allocate or free.
+*/
+class GenSampleLoader  : private Thread
+{
+public:
+    //==============================================================================
+    explicit GenSampleLoader (int numParams)
+        : Thread ("gen sample loader"),
+          m_NumParams (numParams),
+          m_Pending (new std::atomic<GenSampleData*>[(size_t) jmax (1, numParams)]()),
+          m_RetiredFifo (getNumRetiredSlots (numParams))
+    {
+        m_Bound.calloc (jmax (1, numParams));
+        m_Retired.calloc (getNumRetiredSlots (numParams));
+        m_Files.resize (numParams);
+        m_FormatManager.registerBasicFormats();
+
+        startThread();
+    }
+
+    ~GenSampleLoader() override
+    {
+        stopThread (-1);
+
+        destroyRetiredData();
+
+        for (int i = 0; i < m_NumParams; ++i)
+        {
+            delete m_Pending[i].exchange (nullptr);
+            delete m_Bound[i];
+        }
+
+        m_Pool->purgeUnused();
+    }
+
+    //==============================================================================
+    /** Reads a file for the gen buffer parameter at index. A load for the same
+        parameter that hasn't finished yet is replaced by this one.
+
+        Shared files are mapped from GenSamplePool, so what a patch writes into
+        the buffer reaches every instance in the process that shares the file.
+    */
+    void load (int parameterIndex, const File& file, bool shared = false)
+    {
+        addRequest ({ parameterIndex, file, shared, 0 });
+    }
+
+    /** Streams a file through a window of windowFrames frames rather than loading
+        it, see GenStreamingBuffer.
+    */
+    void stream (int parameterIndex, const File& file, int windowFrames)
+    {
+        addRequest ({ parameterIndex, file, false, jmax (1, windowFrames) });
+    }
+
+    /** The file bound to a parameter last, or loaded for it and about to be. */
+    File getFile (int parameterIndex) const
+    {
+        const ScopedLock sl (m_RequestLock);
+        return m_Files[parameterIndex];
+    }
+
+    //==============================================================================
+    /** Audio thread: binds every file that finished loading since the last call.
+        Returns true if there were any.
+    */
+    bool bindPending (CommonState* state) noexcept
+    {
+        if (! m_AnyPending.exchange (false, std::memory_order_acq_rel))
+            return false;
+
+        for (int i = 0; i < m_NumParams; ++i)
+        {
+            if (m_Pending[i].load (std::memory_order_relaxed) == nullptr)
+                continue;
+
+            // never happens with the queue sized as it is, but if it did, the
+            // rest would wait for the next block rather than overrun it
+            if (m_RetiredFifo.getFreeSpace() == 0)
+            {
+                m_AnyPending.store (true, std::memory_order_release);
+                break;
+            }
+
+            if (auto* data = m_Pending[i].exchange (nullptr, std::memory_order_acq_rel))
+            {
+                C74_GENPLUGIN::setparameter (state, i, 0, data->getReference());
+
+                m_NumBoundStreams += (data->stream != nullptr ? 1 : 0)
+                                   - (m_Bound[i] != nullptr && m_Bound[i]->stream != nullptr ? 1 : 0);
+
+                retire (m_Bound[i]);
+                m_Bound[i] = data;
+            }
+        }
+
+        return true;
+    }
+
+    /** Audio thread: binds everything bound so far to another gen instance, e.g.
+        one that was just restored from a saved state.
+    */
+    void bindAll (CommonState* state) noexcept
+    {
+        for (int i = 0; i < m_NumParams; ++i)
+            if (m_Bound[i] != nullptr)
+                C74_GENPLUGIN::setparameter (state, i, 0, m_Bound[i]->getReference());
+    }
+
+    /** Audio thread: true if any bound buffer is streamed. */
+    bool hasStreams() const noexcept        { return m_NumBoundStreams > 0; }
+
+    /** Audio thread: gen is about to read numFrames frames of every stream from
+        playhead on. Returns how many streams don't have them ready.
+    */
+    int beginStreams (int64 playhead, int numFrames) noexcept
+    {
+        int numUnderruns = 0;
+
+        for (int i = 0; i < m_NumParams; ++i)
+            if (m_Bound[i] != nullptr && m_Bound[i]->stream != nullptr)
+                numUnderruns += m_Bound[i]->stream->beginBlock (playhead, numFrames) ? 0 : 1;
+
+        return numUnderruns;
+    }
+
+    /** Audio thread: gen is done with everything before playhead. */
+    void endStreams (int64 playhead) noexcept
+    {
+        for (int i = 0; i < m_NumParams; ++i)
+            if (m_Bound[i] != nullptr && m_Bound[i]->stream != nullptr)
+                m_Bound[i]->stream->endBlock (playhead);
+    }
+
+private:
+    //==============================================================================
+    struct Request
+    {
+        int index;
+        File file;
+        bool shared;
+        int windowFrames;
+    };
+
+    void addRequest (const Request& request)
+    {
+        const int parameterIndex = request.index;
+        jassert (isPositiveAndBelow (parameterIndex, m_NumParams));
+
+        {
+            const ScopedLock sl (m_RequestLock);
+
+            for (int i = m_Requests.size(); --i >= 0;)
+                if (m_Requests.getReference (i).index == parameterIndex)
+                    m_Requests.remove (i);
+
+            m_Requests.add (request);
+        }
+
+        notify();
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            destroyRetiredData();
+
+            Request request { -1, {}, false, 0 };
+
+            {
+                const ScopedLock sl (m_RequestLock);
+
+                if (! m_Requests.isEmpty())
+                    request = m_Requests.removeAndReturn (0);
+            }
+
+            if (request.index >= 0)
+            {
+                auto* data = request.windowFrames > 0 ? openStream (request.file, request.windowFrames)
+                           : request.shared ? readShared (request.file)
+                           : read (request.file);
+
+                if (data != nullptr)
+                    publish (request.index, data);
+
+                continue;
+            }
+
+            // as long as the audio thread holds on to data it replaced, come back for it
+            wait (m_NumAwaitingRetirement > 0 ? 50 : -1);
+        }
+    }
+
+    GenSampleData* read (const File& file)
+    {
+        auto reader = GenSampleFile::createReader (m_FormatManager, file);
+
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels == 0)
+            return nullptr;
+
+        const size_t numValues = (size_t) reader->lengthInSamples * reader->numChannels;
+
+        std::unique_ptr<GenSampleData> data (new GenSampleData());
+        data->samples.malloc (numValues);
+        data->sampleRate = reader->sampleRate;
+        data->file = file;
+
+        t_sample* dest = data->samples;
+
+        if (! GenSampleFile::readInterleaved (*reader,
+                                              [&] (const t_sample* samples, int numSamples)
+                                              {
+                                                  const size_t count = (size_t) numSamples * reader->numChannels;
+                                                  memcpy (dest, samples, count * sizeof (t_sample));
+                                                  dest += count;
+                                              },
+                                              [this] { return threadShouldExit(); }))
+            return nullptr;
+
+        setInfo (*data, data->samples, reader->lengthInSamples, (int) reader->numChannels);
+        return data.release();
+    }
+
+    GenSampleData* readShared (const File& file)
+    {
+        auto pooled = m_Pool->acquire (file, [this] { return threadShouldExit(); });
+
+        if (pooled == nullptr)
+            return nullptr;
+
+        std::unique_ptr<GenSampleData> data (new GenSampleData());
+        data->pooledSamples = pooled;
+        data->sampleRate = pooled->getSampleRate();
+        data->file = file;
+
+        setInfo (*data, pooled->getSamples(), pooled->getNumFrames(), pooled->getNumChannels());
+        return data.release();
+    }
+
+    GenSampleData* openStream (const File& file, int windowFrames)
+    {
+        // streamed files can be far larger than memory, so they aren't mapped whole
+        std::unique_ptr<AudioFormatReader> reader (m_FormatManager.createReaderFor (file));
+
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels == 0)
+            return nullptr;
+
+        std::unique_ptr<GenSampleData> data (new GenSampleData());
+        data->sampleRate = reader->sampleRate;
+        data->file = file;
+        data->stream.reset (new GenStreamingBuffer (reader.release(), windowFrames));
+
+        setInfo (*data, data->stream->getSamples(), data->stream->getWindowFrames(), data->stream->getNumChannels());
+        return data.release();
+    }
+
+    static void setInfo (GenSampleData& data, t_sample* samples, int64 numFrames, int numChannels)
+    {
+        data.info.dim = (decltype (data.info.dim)) numFrames;
+        data.info.channels = (decltype (data.info.channels)) numChannels;
+        data.info.data = samples;
+    }
+
+    void publish (int index, GenSampleData* data)
+    {
+        {
+            const ScopedLock sl (m_RequestLock);
+            m_Files.set (index, data->file);
+        }
+
+        if (auto* superseded = m_Pending[index].exchange (data, std::memory_order_acq_rel))
+            delete superseded;
+        else
+            ++m_NumAwaitingRetirement;
+
+        m_AnyPending.store (true, std::memory_order_release);
+    }
+
+    /** Every bind puts exactly one entry here, nullptr if nothing was bound before. */
+    void retire (GenSampleData* data) noexcept
+    {
+        int start1, size1, start2, size2;
+        m_RetiredFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        // bindPending checks for room first
+        jassert (size1 + size2 > 0);
+
+        m_Retired[size1 > 0 ? start1 : start2] = data;
+        m_RetiredFifo.finishedWrite (1);
+    }
+
+    void destroyRetiredData()
+    {
+        int start1, size1, start2, size2;
+        m_RetiredFifo.prepareToRead (m_RetiredFifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)  delete m_Retired[start1 + i];
+        for (int i = 0; i < size2; ++i)  delete m_Retired[start2 + i];
+
+        m_RetiredFifo.finishedRead (size1 + size2);
+        m_NumAwaitingRetirement -= jmin (m_NumAwaitingRetirement, size1 + size2);
+
+        if (size1 + size2 > 0)
+            m_Pool->purgeUnused();
+    }
+
+    //==============================================================================
+    /** Before the audio thread runs, every parameter can have data pending, and
+        the loader may publish for each of them again before it empties the queue,
+        so it holds two entries per parameter. An AbstractFifo holds one less than
+        its size.
+    */
+    static int getNumRetiredSlots (int numParams) noexcept     { return 2 * jmax (1, numParams) + 2; }
+
+    const int m_NumParams;
+    AudioFormatManager m_FormatManager;
+    SharedResourcePointer<GenSamplePool> m_Pool;
+
+    CriticalSection m_RequestLock;
+    Array<Request> m_Requests;
+    Array<File> m_Files;
+
+    std::unique_ptr<std::atomic<GenSampleData*>[]> m_Pending;
+    std::atomic<bool> m_AnyPending { false };
+
+    // audio thread only
+    HeapBlock<GenSampleData*> m_Bound;
+    int m_NumBoundStreams = 0;
+
+    AbstractFifo m_RetiredFifo;
+    HeapBlock<GenSampleData*> m_Retired;
+    int m_NumAwaitingRetirement = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenSampleLoader)
+};
+
+
+#endif  // GENSAMPLELOADER_H_INCLUDED
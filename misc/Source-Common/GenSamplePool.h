@@ -0,0 +1,516 @@
+/*
+  ==============================================================================
+
+    GenSamplePool.h
+
+    Audio files converted for gen once and shared by every plugin instance.
+
+  ==============================================================================
+*/
+
+#ifndef GENSAMPLEPOOL_H_INCLUDED
+#define GENSAMPLEPOOL_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_IOS
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/resource.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+//==============================================================================
+/** Reading audio files into gen's sample layout: frames one after another, with
+    the channels of a frame interleaved.
+*/
+namespace GenSampleFile
+{
+    /** A reader for the file; WAV and AIFF are memory mapped as a whole. */
+    inline std::unique_ptr<AudioFormatReader> createReader (AudioFormatManager& formats, const File& file)
+    {
+        if (auto* format = formats.findFormatForFileExtension (file.getFileExtension()))
+        {
+            std::unique_ptr<MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+
+            if (mapped != nullptr && mapped->mapEntireFile())
+                return mapped;
+        }
+
+        return std::unique_ptr<AudioFormatReader> (formats.createReaderFor (file));
+    }
+
+    /** Reads the whole file a slice at a time, calling write (samples, numSamples)
+        with every slice interleaved. Returns false if shouldStop() said so.
+    */
+    template <typename WriteFunction, typename ShouldStopFunction>
+    bool readInterleaved (AudioFormatReader& reader, WriteFunction&& write, ShouldStopFunction&& shouldStop)
+    {
+        constexpr int sliceSize = 1 << 16;
+
+        const int numChannels = (int) reader.numChannels;
+        const int64 numFrames = reader.lengthInSamples;
+
+        AudioBuffer<float> slice (numChannels, (int) jmin ((int64) sliceSize, numFrames));
+        HeapBlock<t_sample> interleaved ((size_t) slice.getNumSamples() * (size_t) numChannels);
+
+        for (int64 start = 0; start < numFrames; start += slice.getNumSamples())
+        {
+            if (shouldStop())
+                return false;
+
+            const int numSamples = (int) jmin ((int64) slice.getNumSamples(), numFrames - start);
+            reader.read (&slice, 0, numSamples, start, true, true);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const float* src = slice.getReadPointer (ch);
+
+                for (int n = 0; n < numSamples; ++n)
+                    interleaved[n * numChannels + ch] = (t_sample) src[n];
+            }
+
+            write (interleaved.get(), numSamples);
+        }
+
+        return true;
+    }
+}
+
+//==============================================================================
+/**
+    A process-wide pool of audio files converted to gen's sample format.
+
+    Each file is converted once into a cache file in a directory of the user's
+    own in the temp directory, which is then memory mapped copy-on-write. Every instance that loads the same file
+    (same path, modification time, format and sample type) gets the same
+    mapping, so 40 instances of a sampler hold one copy of its samples, and
+    the OS can drop those pages and fetch them back from the cache file
+    instead of swapping. A cache file left by another process using the same
+    file is mapped as it is, once its header shows it was converted from that
+    very file.
+
+    Access it through a SharedResourcePointer; the pool lives as long as
+    anything holds one. A patch may write into the samples (e.g. with poke),
+    but every instance in the process that loaded the file sees what it wrote;
+    the pages it writes to become its process's own and never reach the cache
+    file.
+*/
+class GenSamplePool
+{
+public:
+    //==============================================================================
+    /** A file mapped copy-on-write, so writing to it changes this process's pages
+        but not the file. Where that isn't available, the file is read into
+        memory instead.
+    */
+    class PrivateMapping
+    {
+    public:
+        explicit PrivateMapping (const File& file)
+        {
+           #if JUCE_LINUX || JUCE_MAC || JUCE_IOS
+            const int fd = open (file.getFullPathName().toRawUTF8(), O_RDONLY);
+
+            if (fd == -1)
+                return;
+
+            struct stat info;
+
+            if (fstat (fd, &info) == 0 && info.st_size > 0)
+            {
+                void* mapped = mmap (nullptr, (size_t) info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+                if (mapped != MAP_FAILED)
+                {
+                    m_Data = mapped;
+                    m_Size = (size_t) info.st_size;
+                }
+            }
+
+            close (fd);
+           #else
+            if (file.loadFileAsData (m_Copy))
+            {
+                m_Data = m_Copy.getData();
+                m_Size = m_Copy.getSize();
+            }
+           #endif
+        }
+
+        ~PrivateMapping()
+        {
+           #if JUCE_LINUX || JUCE_MAC || JUCE_IOS
+            if (m_Data != nullptr)
+                munmap (m_Data, m_Size);
+           #endif
+        }
+
+        void* getData() const noexcept      { return m_Data; }
+        size_t getSize() const noexcept     { return m_Size; }
+
+    private:
+        void* m_Data = nullptr;
+        size_t m_Size = 0;
+
+       #if ! (JUCE_LINUX || JUCE_MAC || JUCE_IOS)
+        MemoryBlock m_Copy;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (PrivateMapping)
+    };
+
+    //==============================================================================
+    /** One converted file. Held through Entry::Ptr; the mapping goes away with the
+        last holder.
+    */
+    class Entry  : public ReferenceCountedObject
+    {
+    public:
+        using Ptr = ReferenceCountedObjectPtr<Entry>;
+
+        t_sample* getSamples() const noexcept       { return m_Samples; }
+        int64 getNumFrames() const noexcept         { return m_NumFrames; }
+        int getNumChannels() const noexcept         { return m_NumChannels; }
+        double getSampleRate() const noexcept       { return m_SampleRate; }
+        size_t getSizeInBytes() const noexcept      { return (size_t) m_NumFrames * (size_t) m_NumChannels * sizeof (t_sample); }
+
+    private:
+        friend class GenSamplePool;
+
+        String m_Key;
+        File m_CacheFile;
+        std::unique_ptr<PrivateMapping> m_Mapping;
+        t_sample* m_Samples = nullptr;
+        int64 m_NumFrames = 0;
+        int m_NumChannels = 0;
+        double m_SampleRate = 0;
+    };
+
+    //==============================================================================
+    struct Statistics
+    {
+        int64 numHits = 0;              // found already mapped in this process
+        int64 numCacheFileHits = 0;     // mapped from a cache file another process left
+        int64 numConversions = 0;       // read from the audio file and converted
+        int numEntries = 0;
+        int64 mappedBytes = 0;
+        int64 residentBytes = -1;       // -1 where the OS can't tell
+        int64 minorPageFaults = -1;     // for the whole process, -1 where unavailable
+        int64 majorPageFaults = -1;
+    };
+
+    //==============================================================================
+    GenSamplePool()
+        : m_CacheDirectory (File::getSpecialLocation (File::tempDirectory).getChildFile ("gen-sample-pool-" + getUserName()))
+    {
+        m_Formats.registerBasicFormats();
+    }
+
+    ~GenSamplePool()
+    {
+        for (auto& entry : m_Entries)
+            closeEntry (*entry);
+    }
+
+    //==============================================================================
+    /** Returns the samples of an audio file, converting it if nobody has yet.
+        Call it from a background thread; shouldStop() is checked while converting.
+    */
+    template <typename ShouldStopFunction>
+    Entry::Ptr acquire (const File& file, ShouldStopFunction&& shouldStop)
+    {
+        auto* format = m_Formats.findFormatForFileExtension (file.getFileExtension());
+
+        if (format == nullptr || ! file.existsAsFile())
+            return nullptr;
+
+        const String key = file.getFullPathName()
+                         + "|" + String (file.getSize())
+                         + "|" + String (file.getLastModificationTime().toMilliseconds())
+                         + "|" + format->getFormatName()
+                         + "|" + String ((int) sizeof (t_sample));
+
+        {
+            const ScopedLock sl (m_Lock);
+
+            if (auto existing = find (key))
+            {
+                ++m_NumHits;
+                return existing;
+            }
+        }
+
+        if (! prepareCacheDirectory())
+            return nullptr;
+
+        // converting can take a while, so it happens without the lock; if two
+        // threads race for the same file, the first one to finish wins
+        Entry::Ptr entry (new Entry());
+        entry->m_Key = key;
+        entry->m_CacheFile = m_CacheDirectory.getChildFile (String::toHexString (key.hashCode64()) + ".gensamples");
+
+        bool fromCacheFile = map (*entry);
+
+        if (! fromCacheFile && ! (convert (file, key, entry->m_CacheFile, shouldStop) && map (*entry)))
+            return nullptr;
+
+        const ScopedLock sl (m_Lock);
+
+        if (auto existing = find (key))
+        {
+            ++m_NumHits;
+            return existing;
+        }
+
+        if (fromCacheFile)
+            ++m_NumCacheFileHits;
+        else
+            ++m_NumConversions;
+
+        m_Entries.add (entry);
+        return entry;
+    }
+
+    /** Unmaps the files nobody holds any more. Call it after releasing entries. */
+    void purgeUnused()
+    {
+        const ScopedLock sl (m_Lock);
+
+        for (int i = m_Entries.size(); --i >= 0;)
+        {
+            // only the pool refers to it, and nobody can acquire it while we hold the lock
+            if (m_Entries.getObjectPointerUnchecked (i)->getReferenceCount() == 1)
+            {
+                closeEntry (*m_Entries.getObjectPointerUnchecked (i));
+                m_Entries.remove (i);
+            }
+        }
+    }
+
+    //==============================================================================
+    Statistics getStatistics() const
+    {
+        Statistics stats;
+
+        const ScopedLock sl (m_Lock);
+        stats.numHits = m_NumHits;
+        stats.numCacheFileHits = m_NumCacheFileHits;
+        stats.numConversions = m_NumConversions;
+        stats.numEntries = m_Entries.size();
+
+        for (auto& entry : m_Entries)
+            stats.mappedBytes += (int64) entry->getSizeInBytes();
+
+       #if JUCE_LINUX || JUCE_MAC || JUCE_IOS
+        const size_t pageSize = (size_t) sysconf (_SC_PAGESIZE);
+        stats.residentBytes = 0;
+
+        for (auto& entry : m_Entries)
+        {
+            const size_t length = (size_t) entry->m_Mapping->getSize();
+            const size_t numPages = (length + pageSize - 1) / pageSize;
+            HeapBlock<MincoreFlag> pages (numPages);
+
+            if (mincore (entry->m_Mapping->getData(), length, pages.get()) == 0)
+                for (size_t p = 0; p < numPages; ++p)
+                    if ((pages[p] & 1) != 0)
+                        stats.residentBytes += (int64) pageSize;
+        }
+
+        struct rusage usage;
+
+        if (getrusage (RUSAGE_SELF, &usage) == 0)
+        {
+            stats.minorPageFaults = (int64) usage.ru_minflt;
+            stats.majorPageFaults = (int64) usage.ru_majflt;
+        }
+       #endif
+
+        return stats;
+    }
+
+private:
+    //==============================================================================
+    // the cache file starts with this, followed by the key of the file it was
+    // converted from (path, size, modification time...) and the interleaved
+    // samples, which begin at the next multiple of 64 bytes
+    struct CacheFileHeader
+    {
+        char magic[8];
+        uint32 sampleSize;
+        uint32 numChannels;
+        int64 numFrames;
+        double sampleRate;
+        uint32 keySize;
+        char reserved[28];
+    };
+
+    static_assert (sizeof (CacheFileHeader) == 64, "the samples must stay aligned");
+
+    static constexpr const char* cacheFileMagic = "C74GSM2";
+
+    static size_t getSamplesOffset (uint32 keySize) noexcept
+    {
+        return sizeof (CacheFileHeader) + (((size_t) keySize + 63) & ~(size_t) 63);
+    }
+
+    static String getUserName()
+    {
+       #if JUCE_LINUX || JUCE_MAC || JUCE_IOS
+        return String ((int64) geteuid());
+       #else
+        return File::createLegalFileName (SystemStats::getLogonName());
+       #endif
+    }
+
+    /** Creates the cache directory if it isn't there. As its files are mapped as
+        they are, on POSIX systems it has to be a directory of this user's that
+        nobody else may write to, rather than one someone else put in its place.
+    */
+    bool prepareCacheDirectory() const
+    {
+        if (! m_CacheDirectory.createDirectory())
+            return false;
+
+       #if JUCE_LINUX || JUCE_MAC || JUCE_IOS
+        const String path (m_CacheDirectory.getFullPathName());
+        struct stat info;
+
+        if (lstat (path.toRawUTF8(), &info) != 0 || ! S_ISDIR (info.st_mode) || info.st_uid != geteuid())
+            return false;
+
+        return (info.st_mode & 077) == 0 || chmod (path.toRawUTF8(), 0700) == 0;
+       #else
+        return true;
+       #endif
+    }
+
+   #if JUCE_LINUX
+    using MincoreFlag = unsigned char;
+   #else
+    using MincoreFlag = char;
+   #endif
+
+    Entry::Ptr find (const String& key) const
+    {
+        for (auto& entry : m_Entries)
+            if (entry->m_Key == key)
+                return entry;
+
+        return nullptr;
+    }
+
+    /** Maps the entry's cache file if it exists, matches this build and was
+        converted from the file the entry's key describes.
+    */
+    static bool map (Entry& entry)
+    {
+        if (! entry.m_CacheFile.existsAsFile())
+            return false;
+
+        std::unique_ptr<PrivateMapping> mapping (new PrivateMapping (entry.m_CacheFile));
+
+        if (mapping->getData() == nullptr || mapping->getSize() < sizeof (CacheFileHeader))
+            return false;
+
+        CacheFileHeader header;
+        memcpy (&header, mapping->getData(), sizeof (header));
+
+        const char* data = static_cast<const char*> (mapping->getData());
+        const size_t samplesOffset = getSamplesOffset (header.keySize);
+        const size_t expectedSize = samplesOffset + (size_t) header.numFrames * header.numChannels * sizeof (t_sample);
+
+        if (memcmp (header.magic, cacheFileMagic, sizeof (header.magic)) != 0
+             || header.sampleSize != sizeof (t_sample)
+             || header.numChannels == 0
+             || header.numFrames <= 0
+             || header.keySize > mapping->getSize() - sizeof (header)
+             || mapping->getSize() != expectedSize
+             || String::fromUTF8 (data + sizeof (header), (int) header.keySize) != entry.m_Key)
+            return false;
+
+        entry.m_Samples = reinterpret_cast<t_sample*> (static_cast<char*> (mapping->getData()) + samplesOffset);
+        entry.m_NumFrames = header.numFrames;
+        entry.m_NumChannels = (int) header.numChannels;
+        entry.m_SampleRate = header.sampleRate;
+        entry.m_Mapping = std::move (mapping);
+        return true;
+    }
+
+    template <typename ShouldStopFunction>
+    bool convert (const File& source, const String& key, const File& cacheFile, ShouldStopFunction&& shouldStop)
+    {
+        auto reader = GenSampleFile::createReader (m_Formats, source);
+
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels == 0)
+            return false;
+
+        // written under a temporary name and renamed, so no other process maps it half written;
+        // the name comes from a Random of this thread's own, as the system one isn't thread safe
+        thread_local Random random;
+        const String tempName (cacheFile.getFileNameWithoutExtension() + "_temp"
+                                 + String::toHexString (random.nextInt64()) + cacheFile.getFileExtension());
+        TemporaryFile temp (cacheFile, cacheFile.getSiblingFile (tempName));
+
+        {
+            FileOutputStream out (temp.getFile());
+
+            if (out.failedToOpen())
+                return false;
+
+            CacheFileHeader header {};
+            memcpy (header.magic, cacheFileMagic, sizeof (header.magic));
+            header.sampleSize = sizeof (t_sample);
+            header.numChannels = reader->numChannels;
+            header.numFrames = reader->lengthInSamples;
+            header.sampleRate = reader->sampleRate;
+            header.keySize = (uint32) key.getNumBytesAsUTF8();
+            out.write (&header, sizeof (header));
+            out.write (key.toRawUTF8(), header.keySize);
+            out.writeRepeatedByte (0, getSamplesOffset (header.keySize) - sizeof (header) - header.keySize);
+
+            const int numChannels = (int) reader->numChannels;
+
+            if (! GenSampleFile::readInterleaved (*reader,
+                                                  [&] (const t_sample* samples, int numSamples)
+                                                  {
+                                                      out.write (samples, (size_t) numSamples * (size_t) numChannels * sizeof (t_sample));
+                                                  },
+                                                  shouldStop))
+                return false;
+
+            out.flush();
+
+            if (out.getStatus().failed())
+                return false;
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    static void closeEntry (Entry& entry)
+    {
+        entry.m_Mapping.reset();
+
+        // other processes that still map it keep their pages; where the OS doesn't
+        // allow deleting a mapped file this fails and the file is reused later
+        entry.m_CacheFile.deleteFile();
+    }
+
+    //==============================================================================
+    const File m_CacheDirectory;
+    AudioFormatManager m_Formats;
+
+    CriticalSection m_Lock;
+    ReferenceCountedArray<Entry> m_Entries;
+    int64 m_NumHits = 0, m_NumCacheFileHits = 0, m_NumConversions = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenSamplePool)
+};
+
+
+#endif  // GENSAMPLEPOOL_H_INCLUDED
@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    GenSilenceGate.h
+
+    Tells when gen's perform can be skipped because its input has been silent
+    for longer than the patch's tail.
+
+  ==============================================================================
+*/
+
+#ifndef GENSILENCEGATE_H_INCLUDED
+#define GENSILENCEGATE_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "GenPluginMetadata.h"
+
+//==============================================================================
+/**
+    Most tracks of a large session are silent most of the time. A patch whose
+    output dies away within a known tail once its input stops (set with
+    GEN_SILENCE_TAIL_MS or "silence_tail_ms" in the metadata) doesn't need to
+    run then: after the input has been silent for the tail, the processor skips
+    perform and writes zeros until a block with sound arrives.
+
+    A block counts as silent when no input channel's peak, found with
+    FloatVectorOperations::findMinAndMax, rises above silenceThreshold.
+
+    Patches without inputs, or with MIDI input, make sound on their own, so
+    they're never skipped.
+*/
+class GenSilenceGate
+{
+public:
+    //==============================================================================
+    // about -120 dB, so denormal noise from upstream still counts as silence
+    static constexpr float silenceThreshold = 1.0e-6f;
+
+    GenSilenceGate (bool patchCanSleep)
+        : m_TailMs (patchCanSleep ? GenPluginMetadata::getSilenceTailMs() : -1.0)
+    {
+    }
+
+    /** True if perform may be skipped during silence. */
+    bool isEnabled() const noexcept                 { return m_TailMs >= 0; }
+
+    /** The tail to report to the host, 0 if silence is never skipped. */
+    double getTailSeconds() const noexcept          { return jmax (0.0, m_TailMs / 1000.0); }
+
+    /** Call from prepareToPlay. */
+    void prepare (double sampleRate) noexcept
+    {
+        m_TailSamples = (int64) std::ceil (getTailSeconds() * sampleRate);
+        m_NumSilentSamples = 0;
+    }
+
+    //==============================================================================
+    /** Audio thread: looks at the first numInputChannels of a block and returns
+        true if perform can be skipped for it, because the input has been silent
+        for at least the tail before this block and still is.
+    */
+    template <typename SampleType>
+    bool canSkip (const AudioBuffer<SampleType>& buffer, int numInputChannels) noexcept
+    {
+        if (! isEnabled())
+            return false;
+
+        const int numSamples = buffer.getNumSamples();
+
+        for (int ch = jmin (numInputChannels, buffer.getNumChannels()); --ch >= 0;)
+        {
+            const auto range = FloatVectorOperations::findMinAndMax (buffer.getReadPointer (ch), numSamples);
+
+            if (range.getStart() < -silenceThreshold || range.getEnd() > silenceThreshold)
+            {
+                m_NumSilentSamples = 0;
+                return false;
+            }
+        }
+
+        const bool tailIsOver = m_NumSilentSamples >= m_TailSamples;
+        m_NumSilentSamples = jmin (m_NumSilentSamples + numSamples, m_TailSamples);
+        return tailIsOver;
+    }
+
+private:
+    //==============================================================================
+    const double m_TailMs;
+
+    // audio thread only
+    int64 m_TailSamples = 0;
+    int64 m_NumSilentSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenSilenceGate)
+};
+
+
+#endif  // GENSILENCEGATE_H_INCLUDED
@@ -0,0 +1,300 @@
+/*
+  ==============================================================================
+
+    GenStateFormat.h
+
+    The binary layout the plugin stores its state in.
+
+  ==============================================================================
+*/
+
+#ifndef GENSTATEFORMAT_H_INCLUDED
+#define GENSTATEFORMAT_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+#include "GenParameterTable.h"
+#include "GenStateSnapshot.h"
+
+// gzip gen's own state (and with it the contents of its Data objects), set with GEN_COMPRESS_STATE
+#ifndef C74_COMPRESS_STATE
+ #define C74_COMPRESS_STATE 0
+#endif
+
+//==============================================================================
+/**
+    A saved state is a small fixed header, the value of every parameter and the
+    blob gen's getstate() produces, which carries the contents of the patch's
+    Data objects:
+
+        uint32   magic "C74S"
+        uint16   version
+        uint16   flags
+        uint32   number of parameters
+        uint32   hash of the parameter names
+        float64  parameter values [number of parameters]
+        uint32   size of gen's state
+        uint32   size of gen's state as stored (differs when compressed)
+        uint8    gen's state [stored size]
+
+    Compressed states (version 3) store gen's state in independently deflated
+    chunks of varying size, see GenStateSnapshot, as a uint32 0 followed by the
+    chunks. Version 2 stored the size its chunks all had in place of the 0, and
+    version 1 gzipped gen's state as a whole; both are still read.
+
+    Everything is little endian. Uncompressed states are written straight into
+    the destination block, so saving costs no more than gen's getstate() itself.
+
+    Anything without the magic number is treated as a state saved by earlier
+    versions, which passed gen's JSON state to the host as it was.
+*/
+namespace GenStateFormat
+{
+    enum : uint32 { magic = 0x53343743 };   // "C74S" read as a little endian int
+    enum : uint16 { currentVersion = 3 };
+
+    enum Flags : uint16
+    {
+        compressedGenState = 1 << 0,
+        chunkedGenState    = 1 << 1
+    };
+
+    enum class ReadResult
+    {
+        binary,
+        legacy,
+        invalid
+    };
+
+    //==============================================================================
+    namespace Detail
+    {
+        constexpr size_t headerSize = 16;
+        constexpr size_t genStateHeaderSize = 8;
+
+        inline char* writeInt (char* dest, uint32 value) noexcept
+        {
+            value = ByteOrder::swapIfBigEndian (value);
+            memcpy (dest, &value, sizeof (value));
+            return dest + sizeof (value);
+        }
+
+        inline char* writeShort (char* dest, uint16 value) noexcept
+        {
+            value = ByteOrder::swapIfBigEndian (value);
+            memcpy (dest, &value, sizeof (value));
+            return dest + sizeof (value);
+        }
+
+        inline char* writeDouble (char* dest, double value) noexcept
+        {
+            uint64 bits;
+            memcpy (&bits, &value, sizeof (bits));
+            bits = ByteOrder::swapIfBigEndian (bits);
+            memcpy (dest, &bits, sizeof (bits));
+            return dest + sizeof (bits);
+        }
+
+        inline double readDouble (const char* src) noexcept
+        {
+            uint64 bits = ByteOrder::littleEndianInt64 (src);
+            double value;
+            memcpy (&value, &bits, sizeof (value));
+            return value;
+        }
+
+        /** Hands gen a zero terminated copy unless the blob already ends in one,
+            as gen's setstate() has no size argument to stop at.
+        */
+        inline void setGenState (CommonState* state, const char* genState, size_t size, MemoryBlock& scratch)
+        {
+            if (size > 0 && genState[size - 1] == 0)
+            {
+                C74_GENPLUGIN::setstate (state, genState);
+                return;
+            }
+
+            scratch.ensureSize (size + 1);
+            memcpy (scratch.getData(), genState, size);
+            static_cast<char*> (scratch.getData())[size] = 0;
+
+            C74_GENPLUGIN::setstate (state, static_cast<const char*> (scratch.getData()));
+        }
+    }
+
+    //==============================================================================
+    /** Identifies the parameter set a state was saved with (FNV-1a over the names). */
+    inline uint32 hashParameterNames (const GenParameterTable& info) noexcept
+    {
+        uint32 hash = 2166136261u;
+
+        for (int i = 0; i < info.size(); ++i)
+        {
+            // the terminating zero is hashed too, so "ab", "c" and "a", "bc" differ
+            const char* name = info.getName (i).toRawUTF8();
+
+            do
+                hash = (hash ^ (uint8) *name) * 16777619u;
+            while (*name++ != 0);
+        }
+
+        return hash;
+    }
+
+    /** True if the data starts with a binary state header. */
+    inline bool isBinaryState (const void* data, size_t size) noexcept
+    {
+        return data != nullptr
+            && size >= Detail::headerSize
+            && ByteOrder::littleEndianInt (data) == magic;
+    }
+
+    //==============================================================================
+    /** Replaces the contents of dest with the state of a gen instance.
+
+        getValue (index) returns the value to store for a parameter, so the
+        caller can save what the host sees rather than what gen last received.
+
+        If snapshot is given, gen's state is compressed, and only the parts that
+        changed since the last save with the same snapshot are compressed again.
+    */
+    template <typename GetValueFunction>
+    void write (MemoryBlock& dest, CommonState* state, const GenParameterTable& info,
+                GetValueFunction&& getValue, GenStateSnapshot* snapshot)
+    {
+        const size_t genStateSize = C74_GENPLUGIN::getstatesize (state);
+        const size_t numParams = (size_t) info.size();
+        const size_t genStateStart = Detail::headerSize + numParams * sizeof (double) + Detail::genStateHeaderSize;
+        size_t storedSize = genStateSize;
+
+        if (snapshot != nullptr)
+        {
+            C74_GENPLUGIN::getstate (state, snapshot->prepare (genStateSize));
+            snapshot->update();
+            storedSize = sizeof (uint32) + snapshot->getEncodedSize();
+        }
+
+        dest.setSize (genStateStart + storedSize, false);
+
+        char* p = static_cast<char*> (dest.getData());
+        p = Detail::writeInt (p, magic);
+        p = Detail::writeShort (p, currentVersion);
+        p = Detail::writeShort (p, snapshot != nullptr ? (compressedGenState | chunkedGenState) : 0);
+        p = Detail::writeInt (p, (uint32) numParams);
+        p = Detail::writeInt (p, hashParameterNames (info));
+
+        for (int i = 0; i < (int) numParams; ++i)
+            p = Detail::writeDouble (p, (double) getValue (i));
+
+        p = Detail::writeInt (p, (uint32) genStateSize);
+        p = Detail::writeInt (p, (uint32) storedSize);
+
+        if (snapshot != nullptr)
+        {
+            p = Detail::writeInt (p, 0);
+            snapshot->writeChunks (p);
+        }
+        else
+        {
+            C74_GENPLUGIN::getstate (state, p);
+        }
+    }
+
+    //==============================================================================
+    /** Restores a gen instance from a state saved by write(), or by versions that
+        stored gen's JSON state directly.
+
+        Stored parameter values are applied after gen's state and only if the
+        parameter names still match. Nothing is changed if the data is invalid.
+    */
+    inline ReadResult read (CommonState* state, const GenParameterTable& info,
+                            const void* data, size_t size, MemoryBlock& scratch)
+    {
+        if (data == nullptr || size == 0)
+            return ReadResult::invalid;
+
+        const char* src = static_cast<const char*> (data);
+
+        if (! isBinaryState (data, size))
+        {
+            Detail::setGenState (state, src, size, scratch);
+            return ReadResult::legacy;
+        }
+
+        const uint16 version = ByteOrder::littleEndianShort (src + 4);
+        const uint16 flags = ByteOrder::littleEndianShort (src + 6);
+        const size_t numParams = ByteOrder::littleEndianInt (src + 8);
+        const uint32 layoutHash = ByteOrder::littleEndianInt (src + 12);
+
+        if (version > currentVersion || numParams > (size - Detail::headerSize) / sizeof (double))
+            return ReadResult::invalid;
+
+        const char* values = src + Detail::headerSize;
+        const size_t genStateStart = Detail::headerSize + numParams * sizeof (double) + Detail::genStateHeaderSize;
+
+        if (size < genStateStart)
+            return ReadResult::invalid;
+
+        const size_t genStateSize = ByteOrder::littleEndianInt (src + genStateStart - 8);
+        const size_t storedSize = ByteOrder::littleEndianInt (src + genStateStart - 4);
+
+        // the size is only trusted as far as this patch's state goes, which every
+        // state saved from it fits into, before anything is allocated for it
+        if (storedSize > size - genStateStart || genStateSize > C74_GENPLUGIN::getstatesize (state))
+            return ReadResult::invalid;
+
+        if ((flags & chunkedGenState) != 0)
+        {
+            if (storedSize < sizeof (uint32))
+                return ReadResult::invalid;
+
+            const char* chunks = src + genStateStart;
+            scratch.ensureSize (genStateSize + 1);
+
+            if (! GenStateSnapshot::readChunks (chunks + sizeof (uint32), storedSize - sizeof (uint32),
+                                                static_cast<char*> (scratch.getData()), genStateSize,
+                                                ByteOrder::littleEndianInt (chunks)))
+                return ReadResult::invalid;
+
+            static_cast<char*> (scratch.getData())[genStateSize] = 0;
+
+            if (genStateSize > 0)
+                C74_GENPLUGIN::setstate (state, static_cast<const char*> (scratch.getData()));
+        }
+        else if ((flags & compressedGenState) != 0)
+        {
+            scratch.ensureSize (genStateSize + 1);
+
+            MemoryInputStream in (src + genStateStart, storedSize, false);
+            GZIPDecompressorInputStream unzipper (in);
+
+            if (unzipper.read (scratch.getData(), (int) genStateSize) != (int) genStateSize)
+                return ReadResult::invalid;
+
+            static_cast<char*> (scratch.getData())[genStateSize] = 0;
+
+            if (genStateSize > 0)
+                C74_GENPLUGIN::setstate (state, static_cast<const char*> (scratch.getData()));
+        }
+        else
+        {
+            if (storedSize != genStateSize)
+                return ReadResult::invalid;
+
+            if (genStateSize > 0)
+                Detail::setGenState (state, src + genStateStart, genStateSize, scratch);
+        }
+
+        if ((int) numParams == info.size() && layoutHash == hashParameterNames (info))
+        {
+            for (int i = 0; i < (int) numParams; ++i)
+                C74_GENPLUGIN::setparameter (state, i, (t_param) Detail::readDouble (values + i * sizeof (double)), NULL);
+        }
+
+        return ReadResult::binary;
+    }
+}
+
+
+#endif  // GENSTATEFORMAT_H_INCLUDED
@@ -0,0 +1,261 @@
+/*
+  ==============================================================================
+
+    GenStateLoader.h
+
+    Builds gen instances from saved states away from the audio thread.
+
+  ==============================================================================
+*/
+
+#ifndef GENSTATELOADER_H_INCLUDED
+#define GENSTATELOADER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+#include "GenParameterTable.h"
+#include "GenStateFormat.h"
+
+#include <atomic>
+#include <functional>
+
+//==============================================================================
+/**
+    Loading a state into the gen instance the audio thread is running would
+    either race perform() or stall it for as long as gen takes to parse. So a
+    saved state is restored into a fresh instance on a background thread, and
+    the audio thread swaps that in between two blocks:
+
+        message thread:  load (data)
+        loader thread:   create(), reset(), setstate() ... publish
+        audio thread:    takeLoadedState(), swap pointers, retire (old)
+        loader thread:   destroy (old)
+
+    Both audio thread calls are wait-free, so a preset change never blocks or
+    allocates there. If another load finishes before the audio thread picked up
+    the previous one, the previous one is destroyed without ever being used.
+*/
+class GenStateLoader  : private Thread
+{
+public:
+    //==============================================================================
+    /** initialState is the instance the audio thread starts with. Like every
+        instance the loader publishes, its ownership passes to the loader when
+        the audio thread retire()s it for another, and the loader destroys it.
+    */
+    GenStateLoader (CommonState* initialState, const GenParameterTable& parameterInfo)
+        : Thread ("gen state loader"),
+          m_Info (parameterInfo),
+          m_Latest (initialState),
+          m_RetiredFifo (numRetiredSlots)
+    {
+        startThread();
+    }
+
+    ~GenStateLoader() override
+    {
+        stop();
+
+        destroyRetiredStates();
+
+        if (auto* unused = m_Loaded.exchange (nullptr))
+            C74_GENPLUGIN::destroy (unused);
+    }
+
+    //==============================================================================
+    /** Starts restoring a state saved with GenStateFormat (or gen's own JSON state)
+        into a new instance. The data is copied, and a load that hasn't finished
+        yet is replaced by this one. onLoaded is called once the instance is ready.
+    */
+    void load (const void* data, size_t size, double sampleRate, long vectorSize)
+    {
+        {
+            const ScopedLock sl (m_RequestLock);
+            m_Request.replaceWith (data, size);
+            m_RequestSampleRate = sampleRate > 0 ? sampleRate : 44100;
+            m_RequestVectorSize = vectorSize > 0 ? vectorSize : 64;
+            m_HasRequest = true;
+            ++m_NumRequested;
+        }
+
+        notify();
+    }
+
+    /** Blocks until everything passed to load() so far has been dealt with. */
+    void waitUntilLoaded()
+    {
+        while (m_NumCompleted.load() < m_NumRequested.load() && isThreadRunning())
+            m_CompletedEvent.wait (10);
+    }
+
+    /** Joins the loader thread, so onLoaded is never called again once this
+        returns. Owners call it first thing in their destructor, before tearing
+        down what onLoaded uses; loads after it are never restored.
+    */
+    void stop()
+    {
+        stopThread (-1);
+    }
+
+    /** The instance restored last, whether or not the audio thread has taken it yet,
+        or the initial instance if nothing was loaded. Only valid on the thread
+        that calls load(), after waitUntilLoaded().
+    */
+    CommonState* getLatestState() const noexcept      { return m_Latest.load(); }
+
+    /** The parameter values of the instance restored last. */
+    Array<t_param> getLoadedParameterValues() const
+    {
+        const ScopedLock sl (m_ValuesLock);
+        return m_LoadedValues;
+    }
+
+    /** Called on the loader thread whenever an instance is ready to be taken.
+        Set it before the first load() and leave it alone until stop().
+    */
+    std::function<void()> onLoaded;
+
+    //==============================================================================
+    /** Audio thread: takes a newly restored instance, or returns nullptr. Wait-free. */
+    CommonState* takeLoadedState() noexcept
+    {
+        if (m_Loaded.load (std::memory_order_relaxed) == nullptr)
+            return nullptr;
+
+        return m_Loaded.exchange (nullptr, std::memory_order_acq_rel);
+    }
+
+    /** Audio thread: hands back an instance that's no longer used, to be destroyed
+        on the loader thread. Wait-free.
+    */
+    void retire (CommonState* state) noexcept
+    {
+        int start1, size1, start2, size2;
+        m_RetiredFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        // every retired instance was published by the loader, which empties the
+        // queue before publishing another, so it can't fill up
+        jassert (size1 + size2 > 0);
+
+        m_Retired[size1 > 0 ? start1 : start2] = state;
+        m_RetiredFifo.finishedWrite (1);
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            destroyRetiredStates();
+
+            MemoryBlock request;
+            double sampleRate = 0;
+            long vectorSize = 0;
+            int requestNumber = 0;
+
+            {
+                const ScopedLock sl (m_RequestLock);
+
+                if (m_HasRequest)
+                {
+                    request.swapWith (m_Request);
+                    sampleRate = m_RequestSampleRate;
+                    vectorSize = m_RequestVectorSize;
+                    requestNumber = m_NumRequested.load();
+                    m_HasRequest = false;
+                }
+            }
+
+            if (requestNumber > 0)
+            {
+                build (request, sampleRate, vectorSize);
+
+                m_NumCompleted = requestNumber;
+                m_CompletedEvent.signal();
+                continue;
+            }
+
+            // as long as the audio thread owes us an instance, come back for it
+            wait (m_NumAwaitingRetirement > 0 ? 50 : -1);
+        }
+    }
+
+    void build (const MemoryBlock& data, double sampleRate, long vectorSize)
+    {
+        auto* state = (CommonState*) C74_GENPLUGIN::create (sampleRate, vectorSize);
+        C74_GENPLUGIN::reset (state);
+
+        if (GenStateFormat::read (state, m_Info, data.getData(), data.getSize(), m_Scratch) == GenStateFormat::ReadResult::invalid)
+        {
+            C74_GENPLUGIN::destroy (state);
+            return;
+        }
+
+        {
+            const ScopedLock sl (m_ValuesLock);
+            m_LoadedValues.clearQuick();
+
+            for (int i = 0; i < m_Info.size(); ++i)
+            {
+                t_param value;
+                C74_GENPLUGIN::getparameter (state, i, &value);
+                m_LoadedValues.add (value);
+            }
+        }
+
+        m_Latest = state;
+
+        if (auto* superseded = m_Loaded.exchange (state, std::memory_order_acq_rel))
+            C74_GENPLUGIN::destroy (superseded);
+        else
+            ++m_NumAwaitingRetirement;
+
+        if (onLoaded != nullptr)
+            onLoaded();
+    }
+
+    void destroyRetiredStates()
+    {
+        int start1, size1, start2, size2;
+        m_RetiredFifo.prepareToRead (m_RetiredFifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)  C74_GENPLUGIN::destroy (m_Retired[start1 + i]);
+        for (int i = 0; i < size2; ++i)  C74_GENPLUGIN::destroy (m_Retired[start2 + i]);
+
+        m_RetiredFifo.finishedRead (size1 + size2);
+        m_NumAwaitingRetirement -= jmin (m_NumAwaitingRetirement, size1 + size2);
+    }
+
+    //==============================================================================
+    static constexpr int numRetiredSlots = 8;
+
+    const GenParameterTable& m_Info;
+
+    CriticalSection m_RequestLock;
+    MemoryBlock m_Request;
+    double m_RequestSampleRate = 0;
+    long m_RequestVectorSize = 0;
+    bool m_HasRequest = false;
+
+    std::atomic<int> m_NumRequested { 0 }, m_NumCompleted { 0 };
+    WaitableEvent m_CompletedEvent;
+
+    std::atomic<CommonState*> m_Loaded { nullptr };
+    std::atomic<CommonState*> m_Latest;
+
+    AbstractFifo m_RetiredFifo;
+    CommonState* m_Retired[numRetiredSlots] = {};
+    int m_NumAwaitingRetirement = 0;
+
+    CriticalSection m_ValuesLock;
+    Array<t_param> m_LoadedValues;
+
+    MemoryBlock m_Scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenStateLoader)
+};
+
+
+#endif  // GENSTATELOADER_H_INCLUDED
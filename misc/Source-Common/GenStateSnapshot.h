@@ -0,0 +1,287 @@
+/*
+  ==============================================================================
+
+    GenStateSnapshot.h
+
+    Compressed copy of gen's state that is only re-encoded where it changed.
+
+  ==============================================================================
+*/
+
+#ifndef GENSTATESNAPSHOT_H_INCLUDED
+#define GENSTATESNAPSHOT_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <unordered_map>
+#include <vector>
+
+//==============================================================================
+/**
+    Keeps the last state gen produced together with its compressed form, split
+    into chunks that are deflated independently.
+
+    gen's Data objects can only be reached through getstate(), whose output is
+    JSON, so an edit that changes the length of a number moves everything after
+    it. Chunk boundaries are therefore chosen by content rather than position:
+    a rolling hash over the last 64 bytes ends a chunk wherever its top bits are
+    zero, so the boundaries after an edit fall in the same places as before.
+    Chunks whose bytes match a chunk of the previous state (found by size and
+    boundary hash, then compared) reuse its compressed form, and only chunks
+    that differ (e.g. the part of a Data a patch recorded into) are compressed
+    again.
+
+    Usage: let gen write into prepare(), call update(), then copy the result
+    out with writeChunks(). Not thread safe; meant for the message thread.
+*/
+class GenStateSnapshot
+{
+public:
+    //==============================================================================
+    static constexpr size_t defaultChunkSize = 1 << 16;
+
+    /** Chunks are between a quarter and four times averageChunkSize long, and
+        about averageChunkSize on average.
+    */
+    explicit GenStateSnapshot (size_t averageChunkSize = defaultChunkSize)
+        : m_MinChunkSize (jmax ((size_t) 64, averageChunkSize / 4)),
+          m_MaxChunkSize (jmax ((size_t) 64, averageChunkSize) * 4),
+          m_BoundaryMask (~(uint64) 0 << (64 - getBoundaryBits (averageChunkSize - m_MinChunkSize)))
+    {
+    }
+
+    /** Returns space for a new state of the given size, e.g. for gen's getstate(). */
+    char* prepare (size_t stateSize)
+    {
+        m_Next.ensureSize (jmax ((size_t) 1, stateSize));
+        m_NextSize = stateSize;
+        return static_cast<char*> (m_Next.getData());
+    }
+
+    /** Makes the prepared state current, compressing the chunks that changed.
+        Returns how many chunks were compressed.
+    */
+    int update()
+    {
+        const uint8* next = static_cast<const uint8*> (m_Next.getData());
+        const uint8* previous = static_cast<const uint8*> (m_Current.getData());
+
+        m_PreviousChunks.clear();
+
+        if (m_IsValid)
+            for (size_t c = 0; c < m_Chunks.size(); ++c)
+                m_PreviousChunks.emplace (m_Chunks[c].key, c);
+
+        std::vector<Chunk> chunks;
+        m_NumEncodedChunks = 0;
+
+        for (size_t start = 0; start < m_NextSize;)
+        {
+            Chunk chunk;
+            chunk.offset = start;
+            chunk.size = findChunkEnd (next, start, chunk.key) - start;
+
+            const auto match = m_PreviousChunks.find (chunk.key);
+
+            if (match != m_PreviousChunks.end()
+                 && m_Chunks[match->second].size == chunk.size
+                 && memcmp (next + start, previous + m_Chunks[match->second].offset, chunk.size) == 0)
+            {
+                chunk.encoded = m_Chunks[match->second].encoded;
+            }
+            else
+            {
+                encodeChunk (chunk.encoded, next + start, chunk.size);
+                ++m_NumEncodedChunks;
+            }
+
+            start += chunk.size;
+            chunks.push_back (std::move (chunk));
+        }
+
+        m_Chunks.swap (chunks);
+        m_Current.swapWith (m_Next);
+        m_CurrentSize = m_NextSize;
+        m_IsValid = true;
+
+        return m_NumEncodedChunks;
+    }
+
+    /** Forgets the cached state, so the next update() compresses everything. */
+    void invalidate() noexcept              { m_IsValid = false; }
+
+    //==============================================================================
+    size_t getStateSize() const noexcept    { return m_CurrentSize; }
+    size_t getNumChunks() const noexcept    { return m_Chunks.size(); }
+    int getNumEncodedChunks() const noexcept { return m_NumEncodedChunks; }
+
+    /** The state as it was before compression. */
+    const char* getState() const noexcept   { return static_cast<const char*> (m_Current.getData()); }
+
+    /** The number of bytes writeChunks() produces. */
+    size_t getEncodedSize() const noexcept
+    {
+        size_t total = 0;
+
+        for (auto& chunk : m_Chunks)
+            total += 2 * sizeof (uint32) + chunk.encoded.getSize();
+
+        return total;
+    }
+
+    /** Writes every chunk as its size and the size of its deflated bytes, both
+        little endian uint32s, followed by the deflated bytes. Returns the end of
+        what was written.
+    */
+    char* writeChunks (char* dest) const noexcept
+    {
+        for (auto& chunk : m_Chunks)
+        {
+            dest = writeInt (dest, (uint32) chunk.size);
+            dest = writeInt (dest, (uint32) chunk.encoded.getSize());
+
+            memcpy (dest, chunk.encoded.getData(), chunk.encoded.getSize());
+            dest += chunk.encoded.getSize();
+        }
+
+        return dest;
+    }
+
+    //==============================================================================
+    /** Inflates chunks written by writeChunks() into dest, which must have room for
+        stateSize bytes. States saved before chunks were content defined had chunks
+        of a fixed size and only stored the deflated size of each; pass that size
+        as fixedChunkSize to read them, or 0 otherwise. Returns false if the data
+        doesn't match the sizes given.
+    */
+    static bool readChunks (const char* src, size_t srcSize, char* dest, size_t stateSize, size_t fixedChunkSize)
+    {
+        const size_t headerSize = fixedChunkSize > 0 ? sizeof (uint32) : 2 * sizeof (uint32);
+
+        for (size_t start = 0; start < stateSize;)
+        {
+            if (srcSize < headerSize)
+                return false;
+
+            const size_t size = fixedChunkSize > 0 ? jmin (fixedChunkSize, stateSize - start)
+                                                   : (size_t) ByteOrder::littleEndianInt (src);
+            const size_t storedSize = ByteOrder::littleEndianInt (src + headerSize - sizeof (uint32));
+            src += headerSize;
+            srcSize -= headerSize;
+
+            if (storedSize > srcSize || size == 0 || size > stateSize - start)
+                return false;
+
+            MemoryInputStream in (src, storedSize, false);
+            GZIPDecompressorInputStream unzipper (&in, false, GZIPDecompressorInputStream::deflateFormat);
+
+            if (unzipper.read (dest + start, (int) size) != (int) size)
+                return false;
+
+            start += size;
+            src += storedSize;
+            srcSize -= storedSize;
+        }
+
+        return true;
+    }
+
+private:
+    //==============================================================================
+    struct Chunk
+    {
+        size_t offset = 0, size = 0;
+        uint64 key = 0;             // boundary hash and size, to find the chunk again
+        MemoryBlock encoded;
+    };
+
+    /** Returns where the chunk that starts at start ends, and sets key. */
+    size_t findChunkEnd (const uint8* data, size_t start, uint64& key) const noexcept
+    {
+        const auto& gear = getGearTable();
+        const size_t limit = jmin (m_NextSize, start + m_MaxChunkSize);
+
+        // the hash only depends on the last 64 bytes, so it starts just short of
+        // the minimum size, or at the start of a short last chunk
+        size_t i = limit - start > m_MinChunkSize ? start + m_MinChunkSize - 64 : start;
+        uint64 hash = 0;
+
+        for (const size_t end = jmin (limit, start + m_MinChunkSize); i < end; ++i)
+            hash = (hash << 1) + gear[data[i]];
+
+        for (; i < limit; ++i)
+        {
+            hash = (hash << 1) + gear[data[i]];
+
+            if ((hash & m_BoundaryMask) == 0)
+            {
+                ++i;
+                break;
+            }
+        }
+
+        key = hash ^ ((uint64) (i - start) * 0x9e3779b97f4a7c15ull);
+        return i;
+    }
+
+    static int getBoundaryBits (size_t averageGap) noexcept
+    {
+        int bits = 1;
+
+        while (bits < 32 && ((size_t) 1 << (bits + 1)) <= averageGap)
+            ++bits;
+
+        return bits;
+    }
+
+    /** Random values for every byte, the same in every run. */
+    static const uint64* getGearTable() noexcept
+    {
+        static const auto table = []
+        {
+            std::vector<uint64> values (256);
+            uint64 seed = 0x43373453;   // splitmix64
+
+            for (auto& value : values)
+            {
+                uint64 z = (seed += 0x9e3779b97f4a7c15ull);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+                value = z ^ (z >> 31);
+            }
+
+            return values;
+        }();
+
+        return table.data();
+    }
+
+    static char* writeInt (char* dest, uint32 value) noexcept
+    {
+        value = ByteOrder::swapIfBigEndian (value);
+        memcpy (dest, &value, sizeof (value));
+        return dest + sizeof (value);
+    }
+
+    static void encodeChunk (MemoryBlock& chunk, const uint8* data, size_t size)
+    {
+        MemoryOutputStream out (chunk, false);
+        GZIPCompressorOutputStream zipper (out, 1, GZIPCompressorOutputStream::windowBitsRaw);
+        zipper.write (data, size);
+    }
+
+    const size_t m_MinChunkSize, m_MaxChunkSize;
+    const uint64 m_BoundaryMask;
+
+    MemoryBlock m_Current, m_Next;
+    size_t m_CurrentSize = 0, m_NextSize = 0;
+    std::vector<Chunk> m_Chunks;
+    std::unordered_map<uint64, size_t> m_PreviousChunks;
+    int m_NumEncodedChunks = 0;
+    bool m_IsValid = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenStateSnapshot)
+};
+
+
+#endif  // GENSTATESNAPSHOT_H_INCLUDED
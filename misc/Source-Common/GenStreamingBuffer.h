@@ -0,0 +1,212 @@
+/*
+  ==============================================================================
+
+    GenStreamingBuffer.h
+
+    A gen buffer~/Data that shows a moving window of a file too large to load.
+
+  ==============================================================================
+*/
+
+#ifndef GENSTREAMINGBUFFER_H_INCLUDED
+#define GENSTREAMINGBUFFER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+
+#include <atomic>
+
+//==============================================================================
+/** The background thread every streaming buffer in the process reads on. */
+struct GenStreamingThread  : public TimeSliceThread
+{
+    GenStreamingThread()
+        : TimeSliceThread ("gen streaming")
+    {
+        startThread (6);
+    }
+
+    ~GenStreamingThread() override
+    {
+        stopThread (-1);
+    }
+};
+
+//==============================================================================
+/**
+    A ring of windowFrames frames that gen sees as an ordinary buffer, filled
+    ahead of the playhead from an audio file on the GenStreamingThread.
+
+    Frame f of the file lives at index f % windowFrames, so a patch plays the
+    file by reading the buffer at (position % dim). The position is the host's
+    playhead in samples, and the processor hands it to gen sample by sample on
+    the inlet the metadata names as "stream_position" (see fillPositions()).
+    The audio thread tells the stream where that position is with beginBlock()
+    and endBlock(); the background thread keeps everything from there up to
+    almost a full window ahead in the ring, and starts over from the new
+    position after a jump.
+
+    The ring only reuses the slots of frames the last endBlock() left behind,
+    less some margin for small steps back, so what gen reads isn't overwritten
+    under it. If the frames a block needs aren't there yet, beginBlock()
+    reports an underrun and gen reads whatever the ring held.
+*/
+class GenStreamingBuffer  : private TimeSliceClient
+{
+public:
+    //==============================================================================
+    /** Takes ownership of the reader. */
+    GenStreamingBuffer (AudioFormatReader* sourceReader, int windowFramesToUse)
+        : m_Reader (sourceReader),
+          m_NumChannels ((int) sourceReader->numChannels),
+          m_WindowFrames (jmax ((int) fillSliceSize * 4, windowFramesToUse)),
+          m_Slice (m_NumChannels, fillSliceSize)
+    {
+        m_Ring.calloc ((size_t) m_WindowFrames * (size_t) m_NumChannels);
+        m_Interleaved.malloc ((size_t) fillSliceSize * (size_t) m_NumChannels);
+
+        // fill the start of the file before anything can play
+        while (fill() == 0) {}
+
+        m_Thread->addTimeSliceClient (this);
+    }
+
+    ~GenStreamingBuffer() override
+    {
+        m_Thread->removeTimeSliceClient (this);
+    }
+
+    //==============================================================================
+    t_sample* getSamples() const noexcept       { return m_Ring.get(); }
+    int getWindowFrames() const noexcept        { return m_WindowFrames; }
+    int getNumChannels() const noexcept         { return m_NumChannels; }
+    int64 getLengthInFrames() const noexcept    { return m_Reader->lengthInSamples; }
+    double getSampleRate() const noexcept       { return m_Reader->sampleRate; }
+
+    /** Audio thread: gen is about to read numFrames frames from playhead on.
+        Returns false if they aren't all in the ring yet.
+    */
+    bool beginBlock (int64 playhead, int numFrames) noexcept
+    {
+        // sequentially consistent along with fill(), which publishes the start
+        // of the window before overwriting what falls out of it and then reads
+        // the playhead: either it sees this one, or this sees the new start
+        if (playhead != m_Playhead.load (std::memory_order_relaxed))
+            m_Playhead.store (playhead, std::memory_order_seq_cst);
+
+        const int64 end = jmin (playhead + numFrames, getLengthInFrames());
+
+        return playhead >= end
+            || (playhead >= m_ValidStart.load (std::memory_order_seq_cst)
+                 && end <= m_ValidEnd.load (std::memory_order_acquire));
+    }
+
+    /** Audio thread: gen is done with everything before playhead. */
+    void endBlock (int64 playhead) noexcept
+    {
+        m_Playhead.store (playhead, std::memory_order_release);
+    }
+
+    //==============================================================================
+    /** Fills an inlet with the positions of numFrames frames from firstFrame on,
+        for the patch to read the ring at. Single precision samples only count
+        whole frames exactly up to 2^24, about six minutes at 44.1 kHz.
+    */
+    static void fillPositions (t_sample* dest, int64 firstFrame, int numFrames) noexcept
+    {
+        for (int n = 0; n < numFrames; ++n)
+            dest[n] = (t_sample) (firstFrame + n);
+    }
+
+private:
+    //==============================================================================
+    int useTimeSlice() override
+    {
+        return fill();
+    }
+
+    /** Reads the next slice into the ring. Returns 0 if there is more to read, or
+        how many milliseconds to wait otherwise.
+    */
+    int fill()
+    {
+        const int64 playhead = m_Playhead.load (std::memory_order_acquire);
+        int64 validStart = m_ValidStart.load (std::memory_order_relaxed);
+        int64 validEnd = m_ValidEnd.load (std::memory_order_relaxed);
+
+        // a jump outside the window starts it over at the playhead
+        if (playhead < validStart || playhead > validEnd)
+        {
+            m_ValidStart.store (playhead, std::memory_order_release);
+            m_ValidEnd.store (playhead, std::memory_order_release);
+            validStart = validEnd = playhead;
+        }
+
+        // frames before the playhead are played, so their slots can be reused;
+        // keep a slice in hand for the audio thread stepping back a little
+        const int64 limit = jmin (playhead + m_WindowFrames - fillSliceSize, getLengthInFrames());
+        const int numFrames = (int) jmin ((int64) fillSliceSize, limit - validEnd);
+
+        if (numFrames <= 0)
+            return 10;
+
+        m_Reader->read (&m_Slice, 0, numFrames, validEnd, true, true);
+
+        // the frames whose slots the slice takes leave the window before they're
+        // overwritten, so beginBlock() no longer accepts them
+        const int64 newEnd = validEnd + numFrames;
+
+        if (newEnd - validStart > m_WindowFrames)
+        {
+            validStart = newEnd - m_WindowFrames;
+            m_ValidStart.store (validStart, std::memory_order_seq_cst);
+
+            // a block that stepped back onto them meanwhile starts the window over instead
+            if (m_Playhead.load (std::memory_order_seq_cst) < validStart)
+                return 0;
+        }
+
+        for (int ch = 0; ch < m_NumChannels; ++ch)
+        {
+            const float* src = m_Slice.getReadPointer (ch);
+
+            for (int n = 0; n < numFrames; ++n)
+                m_Interleaved[n * m_NumChannels + ch] = (t_sample) src[n];
+        }
+
+        // the slice may wrap around the end of the ring
+        const int ringStart = (int) (validEnd % m_WindowFrames);
+        const int firstPart = jmin (numFrames, m_WindowFrames - ringStart);
+
+        memcpy (m_Ring + (size_t) ringStart * (size_t) m_NumChannels, m_Interleaved.get(),
+                (size_t) firstPart * (size_t) m_NumChannels * sizeof (t_sample));
+        memcpy (m_Ring.get(), m_Interleaved + (size_t) firstPart * (size_t) m_NumChannels,
+                (size_t) (numFrames - firstPart) * (size_t) m_NumChannels * sizeof (t_sample));
+
+        // and one that did so during the copy finds the window gone at its next block
+        if (m_Playhead.load (std::memory_order_seq_cst) < validStart)
+            return 0;
+
+        m_ValidEnd.store (newEnd, std::memory_order_release);
+        return 0;
+    }
+
+    //==============================================================================
+    static constexpr int fillSliceSize = 1 << 13;
+
+    SharedResourcePointer<GenStreamingThread> m_Thread;
+    std::unique_ptr<AudioFormatReader> m_Reader;
+    const int m_NumChannels, m_WindowFrames;
+
+    HeapBlock<t_sample> m_Ring;
+    AudioBuffer<float> m_Slice;
+    HeapBlock<t_sample> m_Interleaved;
+
+    std::atomic<int64> m_Playhead { 0 }, m_ValidStart { 0 }, m_ValidEnd { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenStreamingBuffer)
+};
+
+
+#endif  // GENSTREAMINGBUFFER_H_INCLUDED
@@ -0,0 +1,776 @@
+/*
+  ==============================================================================
+
+    GenVoiceEngine.h
+
+    Plays the gen patch polyphonically, one gen instance per voice.
+
+  ==============================================================================
+*/
+
+#ifndef GENVOICEENGINE_H_INCLUDED
+#define GENVOICEENGINE_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+#include "GenBufferArena.h"
+#include "GenMidiInput.h"
+#include "GenParameterTable.h"
+#include "GenStreamingBuffer.h"
+#include "GenVoiceWorkers.h"
+
+// set by GEN_VOICES; 0 plays the patch as a single instance
+#ifndef C74_NUM_VOICES
+ #define C74_NUM_VOICES 0
+#endif
+
+// set by GEN_VOICE_THREADS; threads that render voices besides the audio thread
+#ifndef C74_VOICE_THREADS
+ #define C74_VOICE_THREADS 0
+#endif
+
+// set by GEN_MPE; voices follow MPE pitch bend, pressure and timbre note by note
+#ifndef C74_MPE
+ #define C74_MPE 0
+#endif
+
+//==============================================================================
+/**
+    A Synthesiser whose voices each run their own gen instance. Notes reach a
+    voice's instance through a GenMidiMapping, exactly as they reach the single
+    instance otherwise, and host parameters are set on every voice.
+
+    What the voice loop touches per voice (its instance, channel pointers and
+    inlet values) sits in one array of slots, and all voices' gen channels share
+    one GenBufferArena. Idle voices return before touching any of it, so only
+    sounding voices cost anything. A released voice keeps running until its
+    output has stayed below silenceThreshold for releaseSilenceSeconds, which
+    lets gen's own envelopes finish. When every voice is busy, the Synthesiser
+    steals one: a released voice if there is one, otherwise the oldest note,
+    sparing the lowest and highest held.
+
+    gen allocates each instance itself in create(), so the instances' own
+    memory can't be placed in the arena.
+
+    With worker threads, the sounding voices are dealt out among the audio
+    thread and the workers (see GenVoiceWorkers). Each worker adds its voices
+    into an accumulation buffer of its own, the audio thread's go straight into
+    the output, and the audio thread sums the rest once all are done. MIDI is
+    still handled on the audio thread, between sub-blocks.
+
+    In MPE mode an MPESynthesiser with a 15 channel lower zone plays the voices
+    instead, and each note's pitch bend, pressure and timbre go to its own
+    voice. Expression arriving while a note plays is only noted in the voice's
+    slot and handed to gen when the voice next renders, so however dense the
+    controller stream, gen sees at most one change per sub-block.
+*/
+class GenVoiceEngine
+{
+public:
+    //==============================================================================
+    GenVoiceEngine (const GenParameterTable& parameterInfo, int numVoices, int numThreads, bool useMpe)
+        : m_Mapping (parameterInfo, C74_GENPLUGIN::num_inputs()),
+          m_NumVoices (numVoices),
+          m_NumInputs (C74_GENPLUGIN::num_inputs()),
+          m_NumOutputs (C74_GENPLUGIN::num_outputs()),
+          m_PositionInlet (GenPluginMetadata::getStreamPositionInlet (C74_GENPLUGIN::num_inputs())),
+          m_IsMpe (useMpe),
+          m_Buffers (numVoices * C74_GENPLUGIN::num_inputs(), numVoices * C74_GENPLUGIN::num_outputs()),
+          m_Workers (jlimit (0, jmax (0, numVoices - 1), numThreads))
+    {
+        // without voices the patch plays as a single instance, and none of this is needed
+        if (numVoices <= 0)
+            return;
+
+        m_Slots.calloc (numVoices);
+        m_Voices.calloc (numVoices);
+        m_MpeVoices.calloc (numVoices);
+        m_ActiveVoices.calloc (numVoices);
+        m_InletValues.calloc (jmax (1, numVoices * m_NumInputs));
+        m_ChannelValues.malloc (16 * GenMidiMapping::numSources);
+        m_PlayedValues.malloc (jmax (1, C74_GENPLUGIN::num_params()));
+
+        for (int i = 0; i < 16 * GenMidiMapping::numSources; ++i)
+            m_ChannelValues[i] = -1.0;
+
+        if (m_IsMpe)
+            m_MpeSynth.reset (new MpeSynth (*this));
+        else
+            m_Synth.reset (new VoiceSynth (*this));
+
+        for (int v = 0; v < numVoices; ++v)
+        {
+            Slot& slot = m_Slots[v];
+            slot.state = (CommonState*) C74_GENPLUGIN::create (44100, 64);
+            slot.inletValues = m_InletValues + v * m_NumInputs;
+            C74_GENPLUGIN::reset (slot.state);
+
+            // every instance of a patch has a state of the same size
+            if (v == 0)
+            {
+                m_StateSize = C74_GENPLUGIN::getstatesize (slot.state);
+                m_StateScratch.malloc (jmax ((size_t) 1, m_StateSize));
+            }
+
+            if (m_IsMpe)
+            {
+                m_MpeVoices[v] = new MpeVoice (*this, slot);
+                m_MpeSynth->addVoice (m_MpeVoices[v]);
+            }
+            else
+            {
+                m_Voices[v] = new Voice (*this, slot);
+                m_Synth->addVoice (m_Voices[v]);
+            }
+        }
+
+        if (m_IsMpe)
+        {
+            MPEZoneLayout layout;
+            layout.setLowerZone (15);
+            m_MpeSynth->setZoneLayout (layout);
+            m_MpeSynth->setVoiceStealingEnabled (true);
+        }
+        else
+        {
+            m_Synth->addSound (new Sound());
+            m_Synth->setNoteStealingEnabled (true);
+        }
+    }
+
+    ~GenVoiceEngine()
+    {
+        // the synthesisers own the voices, which refer to the slots
+        m_Synth.reset();
+        m_MpeSynth.reset();
+
+        for (int v = 0; v < m_NumVoices; ++v)
+            C74_GENPLUGIN::destroy (m_Slots[v].state);
+    }
+
+    //==============================================================================
+    bool isEnabled() const noexcept                         { return m_NumVoices > 0; }
+    bool isMpe() const noexcept                             { return m_IsMpe; }
+    int getNumVoices() const noexcept                       { return m_NumVoices; }
+    int getNumWorkers() const noexcept                      { return m_Workers.getNumWorkers(); }
+    CommonState* getVoiceState (int voice) const noexcept   { return m_Slots[voice].state; }
+
+    /** Sizes every voice's channels for blocks of up to maxBlockSize samples.
+        Not for the audio thread.
+    */
+    void prepare (double sampleRate, int maxBlockSize)
+    {
+        m_Buffers.allocate (maxBlockSize);
+        m_BlockSize = maxBlockSize;
+
+        for (int v = 0; v < m_NumVoices; ++v)
+        {
+            Slot& slot = m_Slots[v];
+            slot.state->sr = sampleRate;
+            slot.state->vs = maxBlockSize;
+            slot.inputs = m_Buffers.getInputs() + v * m_NumInputs;
+            slot.outputs = m_Buffers.getOutputs() + v * m_NumOutputs;
+        }
+
+        // the audio thread renders into the output, the others into their own buffers
+        m_FloatAccumulators.resize ((size_t) m_Workers.getNumWorkers());
+        m_DoubleAccumulators.resize ((size_t) m_Workers.getNumWorkers());
+
+        for (int w = 1; w < m_Workers.getNumWorkers(); ++w)
+        {
+            m_FloatAccumulators[(size_t) w].setSize (m_NumOutputs, maxBlockSize);
+            m_DoubleAccumulators[(size_t) w].setSize (m_NumOutputs, maxBlockSize);
+        }
+
+        if (m_Synth != nullptr)
+            m_Synth->setCurrentPlaybackSampleRate (sampleRate);
+
+        if (m_MpeSynth != nullptr)
+            m_MpeSynth->setCurrentPlaybackSampleRate (sampleRate);
+
+        m_ReleaseSilenceSamples = roundToInt (releaseSilenceSeconds * sampleRate);
+    }
+
+    /** The number of voices currently sounding, released ones included. */
+    int getNumActiveVoices() const noexcept
+    {
+        int numActive = 0;
+
+        for (int v = 0; v < m_NumVoices; ++v)
+            numActive += isSounding (v) ? 1 : 0;
+
+        return numActive;
+    }
+
+    //==============================================================================
+    /** Audio thread: sets a gen parameter on every voice. */
+    void setParameter (int index, t_param value) noexcept
+    {
+        for (int v = 0; v < m_NumVoices; ++v)
+            C74_GENPLUGIN::setparameter (m_Slots[v].state, index, value, NULL);
+    }
+
+    /** Audio thread: the stream position of the block about to be rendered, for
+        the "stream_position" inlet (see GenStreamingBuffer).
+    */
+    void setStreamPosition (int64 blockPosition) noexcept
+    {
+        m_BlockPosition = blockPosition;
+    }
+
+    /** Audio thread: gives every voice the state of another instance, e.g. one
+        that was just restored from a saved state: its parameter values and the
+        contents of its Data objects, which gen copies without allocating.
+        Parameters MIDI plays (note, gate and so on) keep each voice's own values,
+        so sounding notes carry on as they were.
+
+        States are saved from that other instance alone, so what voices write to
+        their Data while playing isn't saved.
+    */
+    void copyState (CommonState* source) noexcept
+    {
+        if (m_NumVoices <= 0)
+            return;
+
+        if (C74_GENPLUGIN::getstatesize (source) > m_StateSize)
+        {
+            jassertfalse;   // not an instance of this patch
+            copyParameters (source);
+            return;
+        }
+
+        C74_GENPLUGIN::getstate (source, m_StateScratch);
+
+        for (int v = 0; v < m_NumVoices; ++v)
+        {
+            CommonState* state = m_Slots[v].state;
+
+            for (int i = 0; i < C74_GENPLUGIN::num_params(); ++i)
+                if (m_Mapping.drivesParameter (i))
+                    C74_GENPLUGIN::getparameter (state, i, &m_PlayedValues[i]);
+
+            C74_GENPLUGIN::setstate (state, m_StateScratch);
+
+            for (int i = 0; i < C74_GENPLUGIN::num_params(); ++i)
+                if (m_Mapping.drivesParameter (i))
+                    C74_GENPLUGIN::setparameter (state, i, m_PlayedValues[i], NULL);
+        }
+    }
+
+    /** Audio thread: gives every voice the parameter values of another instance,
+        leaving the parameters MIDI plays alone, as copyState() does.
+    */
+    void copyParameters (CommonState* source) noexcept
+    {
+        for (int i = 0; i < C74_GENPLUGIN::num_params(); ++i)
+        {
+            if (m_Mapping.drivesParameter (i))
+                continue;
+
+            t_param value;
+            C74_GENPLUGIN::getparameter (source, i, &value);
+            setParameter (i, value);
+        }
+    }
+
+    /** Audio thread: replaces numSamples samples of the buffer from startSample
+        on with the sum of all voices, playing the notes in midiMessages that fall
+        into that range. Ranges longer than prepare()'s block size are rendered a
+        block at a time, as that's all the workers' accumulators hold.
+    */
+    template <typename FloatType>
+    void render (AudioBuffer<FloatType>& buffer, const MidiBuffer& midiMessages, int startSample, int numSamples) noexcept
+    {
+        jassert (isEnabled() && m_BlockSize > 0);
+        buffer.clear (startSample, numSamples);
+
+        for (int done = 0; done < numSamples && m_BlockSize > 0; )
+        {
+            const int num = jmin (numSamples - done, m_BlockSize);
+
+            if (m_IsMpe)
+                m_MpeSynth->renderNextBlock (buffer, midiMessages, startSample + done, num);
+            else
+                m_Synth->renderNextBlock (buffer, midiMessages, startSample + done, num);
+
+            done += num;
+        }
+    }
+
+    //==============================================================================
+    static constexpr double releaseSilenceSeconds = 0.05;
+    static constexpr double silenceThreshold = 1.0e-4;    // -80 dB
+
+private:
+    //==============================================================================
+    enum PendingExpression
+    {
+        pendingPitchbend = 1 << 0,
+        pendingPressure = 1 << 1,
+        pendingTimbre = 1 << 2
+    };
+
+    struct Slot
+    {
+        CommonState* state;
+        t_sample** inputs;
+        t_sample** outputs;
+        t_sample* inletValues;
+        int silentSamples;
+        bool releasing;
+
+        // MPE expression not handed to gen yet, see PendingExpression
+        int pending;
+        double pitchbend, pressure, timbre;
+    };
+
+    struct Sound  : public SynthesiserSound
+    {
+        bool appliesToNote (int) override       { return true; }
+        bool appliesToChannel (int) override    { return true; }
+    };
+
+    /** Hands rendering back to the engine, which spreads it across the workers. */
+    struct VoiceSynth  : public Synthesiser
+    {
+        explicit VoiceSynth (GenVoiceEngine& engine)
+            : m_Engine (engine)
+        {
+        }
+
+        void renderVoices (AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+        {
+            m_Engine.renderVoices (outputAudio, m_Engine.m_FloatAccumulators, startSample, numSamples);
+        }
+
+        void renderVoices (AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+        {
+            m_Engine.renderVoices (outputAudio, m_Engine.m_DoubleAccumulators, startSample, numSamples);
+        }
+
+        // the synthesiser keeps the pitch wheel per channel itself, but nothing else
+        void handleController (int midiChannel, int controllerNumber, int controllerValue) override
+        {
+            m_Engine.setChannelValue (midiChannel, GenMidiMapping::firstController + controllerNumber, controllerValue / 127.0);
+            Synthesiser::handleController (midiChannel, controllerNumber, controllerValue);
+        }
+
+        void handleChannelPressure (int midiChannel, int channelPressureValue) override
+        {
+            m_Engine.setChannelValue (midiChannel, GenMidiMapping::pressure, channelPressureValue / 127.0);
+            Synthesiser::handleChannelPressure (midiChannel, channelPressureValue);
+        }
+
+        GenVoiceEngine& m_Engine;
+    };
+
+    /** The same for MPE, which also steals voices without sorting a copy of them. */
+    struct MpeSynth  : public MPESynthesiser
+    {
+        explicit MpeSynth (GenVoiceEngine& engine)
+            : m_Engine (engine)
+        {
+        }
+
+        void renderNextSubBlock (AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+        {
+            m_Engine.renderVoices (outputAudio, m_Engine.m_FloatAccumulators, startSample, numSamples);
+        }
+
+        void renderNextSubBlock (AudioBuffer<double>& outputAudio, int startSample, int numSamples) override
+        {
+            m_Engine.renderVoices (outputAudio, m_Engine.m_DoubleAccumulators, startSample, numSamples);
+        }
+
+        MPESynthesiserVoice* findVoiceToSteal (MPENote) const override
+        {
+            MPESynthesiserVoice* oldest = nullptr;
+            MPESynthesiserVoice* oldestReleased = nullptr;
+
+            for (int v = 0; v < m_Engine.m_NumVoices; ++v)
+            {
+                auto* voice = m_Engine.m_MpeVoices[v];
+                auto*& candidate = voice->isPlayingButReleased() ? oldestReleased : oldest;
+
+                if (candidate == nullptr || voice->noteOnTime < candidate->noteOnTime)
+                    candidate = voice;
+            }
+
+            return oldestReleased != nullptr ? oldestReleased : oldest;
+        }
+
+        GenVoiceEngine& m_Engine;
+    };
+
+    template <typename FloatType>
+    struct RenderJob
+    {
+        GenVoiceEngine& engine;
+        AudioBuffer<FloatType>& output;
+        std::vector<AudioBuffer<FloatType>>& accumulators;
+        int startSample, numSamples, numWorkers;
+
+        static void run (void* context, int worker)
+        {
+            auto& job = *static_cast<RenderJob*> (context);
+
+            if (worker >= job.numWorkers)
+                return;
+
+            // the accumulators only hold one sub-block, so the workers render from their start
+            AudioBuffer<FloatType>& dest = worker == 0 ? job.output : job.accumulators[(size_t) worker];
+            const int destStart = worker == 0 ? job.startSample : 0;
+
+            if (worker > 0)
+                dest.clear (0, job.numSamples);
+
+            for (int i = worker; i < job.engine.m_NumActiveVoices; i += job.numWorkers)
+                job.engine.renderVoice (job.engine.m_ActiveVoices[i], dest, destStart, job.numSamples);
+        }
+    };
+
+    //==============================================================================
+    class Voice  : public SynthesiserVoice
+    {
+    public:
+        Voice (GenVoiceEngine& engine, Slot& slot)
+            : m_Engine (engine), m_Slot (slot)
+        {
+        }
+
+        bool canPlaySound (SynthesiserSound*) override      { return true; }
+
+        void startNote (int midiNoteNumber, float velocity, SynthesiserSound*, int currentPitchWheelPosition) override
+        {
+            m_Slot.releasing = false;
+
+            // the synthesiser has just set the channel, which controllerMoved() never saw
+            for (int channel = 1; channel <= 16; ++channel)
+                if (isPlayingChannel (channel))
+                    m_Engine.sendChannelValues (m_Slot, channel);
+
+            m_Engine.send (m_Slot, GenMidiMapping::pitchbend, m_Engine.getPitchBend (currentPitchWheelPosition));
+            m_Engine.send (m_Slot, GenMidiMapping::note, midiNoteNumber);
+            m_Engine.send (m_Slot, GenMidiMapping::velocity, velocity);
+            m_Engine.send (m_Slot, GenMidiMapping::gate, 1.0);
+        }
+
+        void stopNote (float, bool allowTailOff) override
+        {
+            m_Engine.send (m_Slot, GenMidiMapping::gate, 0.0);
+
+            if (allowTailOff)
+                m_Engine.beginRelease (m_Slot);
+            else
+                clearCurrentNote();
+        }
+
+        void pitchWheelMoved (int newPitchWheelValue) override
+        {
+            m_Engine.send (m_Slot, GenMidiMapping::pitchbend, m_Engine.getPitchBend (newPitchWheelValue));
+        }
+
+        void controllerMoved (int controllerNumber, int newControllerValue) override
+        {
+            m_Engine.send (m_Slot, GenMidiMapping::firstController + controllerNumber, newControllerValue / 127.0);
+        }
+
+        void channelPressureChanged (int newChannelPressureValue) override
+        {
+            m_Engine.send (m_Slot, GenMidiMapping::pressure, newChannelPressureValue / 127.0);
+        }
+
+        void aftertouchChanged (int newAftertouchValue) override
+        {
+            m_Engine.send (m_Slot, GenMidiMapping::pressure, newAftertouchValue / 127.0);
+        }
+
+        void renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+        {
+            render (outputBuffer, startSample, numSamples);
+        }
+
+        void renderNextBlock (AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+        {
+            render (outputBuffer, startSample, numSamples);
+        }
+
+    private:
+        template <typename FloatType>
+        void render (AudioBuffer<FloatType>& outputBuffer, int startSample, int numSamples) noexcept
+        {
+            if (isVoiceActive() && ! m_Engine.renderSlot (m_Slot, outputBuffer, startSample, numSamples))
+                clearCurrentNote();
+        }
+
+        GenVoiceEngine& m_Engine;
+        Slot& m_Slot;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Voice)
+    };
+
+    //==============================================================================
+    class MpeVoice  : public MPESynthesiserVoice
+    {
+    public:
+        MpeVoice (GenVoiceEngine& engine, Slot& slot)
+            : m_Engine (engine), m_Slot (slot)
+        {
+        }
+
+        void noteStarted() override
+        {
+            const MPENote note = getCurrentlyPlayingNote();
+
+            m_Slot.releasing = false;
+            m_Slot.pending = 0;
+
+            m_Engine.send (m_Slot, GenMidiMapping::pitchbend, note.totalPitchbendInSemitones);
+            m_Engine.send (m_Slot, GenMidiMapping::pressure, note.pressure.asUnsignedFloat());
+            m_Engine.send (m_Slot, GenMidiMapping::timbre, note.timbre.asUnsignedFloat());
+            m_Engine.send (m_Slot, GenMidiMapping::note, note.initialNote);
+            m_Engine.send (m_Slot, GenMidiMapping::velocity, note.noteOnVelocity.asUnsignedFloat());
+            m_Engine.send (m_Slot, GenMidiMapping::gate, 1.0);
+        }
+
+        void noteStopped (bool allowTailOff) override
+        {
+            m_Engine.send (m_Slot, GenMidiMapping::gate, 0.0);
+
+            if (allowTailOff)
+                m_Engine.beginRelease (m_Slot);
+            else
+                clearCurrentNote();
+        }
+
+        void notePitchbendChanged() override
+        {
+            m_Slot.pitchbend = getCurrentlyPlayingNote().totalPitchbendInSemitones;
+            m_Slot.pending |= pendingPitchbend;
+        }
+
+        void notePressureChanged() override
+        {
+            m_Slot.pressure = getCurrentlyPlayingNote().pressure.asUnsignedFloat();
+            m_Slot.pending |= pendingPressure;
+        }
+
+        void noteTimbreChanged() override
+        {
+            m_Slot.timbre = getCurrentlyPlayingNote().timbre.asUnsignedFloat();
+            m_Slot.pending |= pendingTimbre;
+        }
+
+        void noteKeyStateChanged() override {}
+
+        void renderNextBlock (AudioBuffer<float>& outputBuffer, int startSample, int numSamples) override
+        {
+            render (outputBuffer, startSample, numSamples);
+        }
+
+        void renderNextBlock (AudioBuffer<double>& outputBuffer, int startSample, int numSamples) override
+        {
+            render (outputBuffer, startSample, numSamples);
+        }
+
+    private:
+        template <typename FloatType>
+        void render (AudioBuffer<FloatType>& outputBuffer, int startSample, int numSamples) noexcept
+        {
+            if (! isActive())
+                return;
+
+            if (m_Slot.pending != 0)
+            {
+                if (m_Slot.pending & pendingPitchbend)  m_Engine.send (m_Slot, GenMidiMapping::pitchbend, m_Slot.pitchbend);
+                if (m_Slot.pending & pendingPressure)   m_Engine.send (m_Slot, GenMidiMapping::pressure, m_Slot.pressure);
+                if (m_Slot.pending & pendingTimbre)     m_Engine.send (m_Slot, GenMidiMapping::timbre, m_Slot.timbre);
+
+                m_Slot.pending = 0;
+            }
+
+            if (! m_Engine.renderSlot (m_Slot, outputBuffer, startSample, numSamples))
+                clearCurrentNote();
+        }
+
+        GenVoiceEngine& m_Engine;
+        Slot& m_Slot;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MpeVoice)
+    };
+
+    //==============================================================================
+    double getPitchBend (int pitchWheelPosition) const noexcept
+    {
+        return (pitchWheelPosition - 8192) / 8192.0 * m_Mapping.getPitchBendRange();
+    }
+
+    void send (Slot& slot, int source, double value) noexcept
+    {
+        m_Mapping.send (source, value,
+                        [&slot] (int index, t_param parameterValue) { C74_GENPLUGIN::setparameter (slot.state, index, parameterValue, NULL); },
+                        [&slot] (int inlet, t_sample inletValue) { slot.inletValues[inlet] = inletValue; });
+    }
+
+    void setChannelValue (int midiChannel, int source, double value) noexcept
+    {
+        if (isPositiveAndBelow (midiChannel - 1, 16) && m_Mapping.isMapped (source))
+            m_ChannelValues[(midiChannel - 1) * GenMidiMapping::numSources + source] = value;
+    }
+
+    /** Gives a voice starting a note on midiChannel the controllers and pressure
+        last sent on it, which only reached the voices sounding at the time.
+    */
+    void sendChannelValues (Slot& slot, int midiChannel) noexcept
+    {
+        const double* values = m_ChannelValues + (midiChannel - 1) * GenMidiMapping::numSources;
+
+        for (int source = GenMidiMapping::pressure; source < GenMidiMapping::numSources; ++source)
+            if (values[source] >= 0.0)
+                send (slot, source, values[source]);
+    }
+
+    static void beginRelease (Slot& slot) noexcept
+    {
+        slot.releasing = true;
+        slot.silentSamples = 0;
+    }
+
+    bool isSounding (int voice) const noexcept
+    {
+        return m_IsMpe ? m_MpeVoices[voice]->isActive() : m_Voices[voice]->isVoiceActive();
+    }
+
+    template <typename FloatType>
+    void renderVoice (int voice, AudioBuffer<FloatType>& outputBuffer, int startSample, int numSamples) noexcept
+    {
+        if (m_IsMpe)
+            m_MpeVoices[voice]->renderNextBlock (outputBuffer, startSample, numSamples);
+        else
+            m_Voices[voice]->renderNextBlock (outputBuffer, startSample, numSamples);
+    }
+
+    template <typename FloatType>
+    void renderVoices (AudioBuffer<FloatType>& output, std::vector<AudioBuffer<FloatType>>& accumulators,
+                       int startSample, int numSamples) noexcept
+    {
+        m_NumActiveVoices = 0;
+        m_RenderPosition = m_BlockPosition + startSample;
+
+        for (int v = 0; v < m_NumVoices; ++v)
+            if (isSounding (v))
+                m_ActiveVoices[m_NumActiveVoices++] = v;
+
+        RenderJob<FloatType> job { *this, output, accumulators, startSample, numSamples,
+                                   jmin (m_Workers.getNumWorkers(), m_NumActiveVoices) };
+
+        if (job.numWorkers <= 1)
+        {
+            RenderJob<FloatType>::run (&job, 0);
+            return;
+        }
+
+        m_Workers.run (&RenderJob<FloatType>::run, &job);
+
+        const int numChannels = jmin (m_NumOutputs, output.getNumChannels());
+
+        for (int w = 1; w < job.numWorkers; ++w)
+            for (int ch = 0; ch < numChannels; ++ch)
+                output.addFrom (ch, startSample, accumulators[(size_t) w], ch, 0, numSamples);
+    }
+
+    /** Runs a voice's gen instance and adds its output to the buffer. Returns
+        false once a released voice has fallen silent.
+    */
+    template <typename FloatType>
+    bool renderSlot (Slot& slot, AudioBuffer<FloatType>& outputBuffer, int startSample, int numSamples) noexcept
+    {
+        const int numOutputs = jmin (m_NumOutputs, outputBuffer.getNumChannels());
+        const int maxBlockSize = m_Buffers.getMaxBlockSize();
+
+        for (int done = 0; done < numSamples; )
+        {
+            const int num = jmin (numSamples - done, maxBlockSize);
+
+            // inlets MIDI doesn't drive stay silent
+            for (int i = 0; i < m_NumInputs; ++i)
+                if (m_Mapping.drivesInlet (i))
+                    FloatVectorOperations::fill (slot.inputs[i], slot.inletValues[i], num);
+                else if (i == m_PositionInlet)
+                    GenStreamingBuffer::fillPositions (slot.inputs[i], m_RenderPosition + done, num);
+
+            C74_GENPLUGIN::perform (slot.state, slot.inputs, m_NumInputs, slot.outputs, m_NumOutputs, num);
+
+            for (int ch = 0; ch < numOutputs; ++ch)
+            {
+                FloatType* dest = outputBuffer.getWritePointer (ch, startSample + done);
+                const t_sample* src = slot.outputs[ch];
+
+                for (int n = 0; n < num; ++n)
+                    dest[n] += (FloatType) src[n];
+            }
+
+            done += num;
+
+            if (slot.releasing && hasFallenSilent (slot, num))
+                return false;
+        }
+
+        return true;
+    }
+
+    bool hasFallenSilent (Slot& slot, int numSamples) noexcept
+    {
+        for (int ch = 0; ch < m_NumOutputs; ++ch)
+        {
+            const auto range = FloatVectorOperations::findMinAndMax (slot.outputs[ch], numSamples);
+
+            if (jmax (-range.getStart(), range.getEnd()) > (t_sample) silenceThreshold)
+            {
+                slot.silentSamples = 0;
+                return false;
+            }
+        }
+
+        slot.silentSamples += numSamples;
+        return slot.silentSamples >= m_ReleaseSilenceSamples;
+    }
+
+    //==============================================================================
+    GenMidiMapping m_Mapping;
+    const int m_NumVoices, m_NumInputs, m_NumOutputs, m_PositionInlet;
+    const bool m_IsMpe;
+    int64 m_BlockPosition = 0;
+    int64 m_RenderPosition = 0;     // of the sub-block being rendered, wherever a voice writes it
+
+    HeapBlock<Slot> m_Slots;
+    HeapBlock<Voice*> m_Voices;
+    HeapBlock<MpeVoice*> m_MpeVoices;
+    HeapBlock<t_sample> m_InletValues;
+    HeapBlock<double> m_ChannelValues;     // per MIDI channel and source, -1 until one arrives
+
+    // copyState()'s room for gen's state, and for what MIDI set while it's replaced
+    HeapBlock<char> m_StateScratch;
+    size_t m_StateSize = 0;
+    HeapBlock<t_param> m_PlayedValues;
+    GenBufferArena m_Buffers;
+    int m_ReleaseSilenceSamples = 2205;
+    int m_BlockSize = 0;            // the most render() hands the synthesiser at once
+
+    // only the one that plays the voices exists, and neither without voices
+    std::unique_ptr<VoiceSynth> m_Synth;
+    std::unique_ptr<MpeSynth> m_MpeSynth;
+
+    // sounding voices of the sub-block being rendered, and where they go
+    GenVoiceWorkers m_Workers;
+    HeapBlock<int> m_ActiveVoices;
+    int m_NumActiveVoices = 0;
+    std::vector<AudioBuffer<float>> m_FloatAccumulators;
+    std::vector<AudioBuffer<double>> m_DoubleAccumulators;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenVoiceEngine)
+};
+
+
+#endif  // GENVOICEENGINE_H_INCLUDED
@@ -0,0 +1,250 @@
+/*
+  ==============================================================================
+
+    GenVoiceWorkers.h
+
+    A few high priority threads that help the audio thread through one block.
+
+  ==============================================================================
+*/
+
+#ifndef GENVOICEWORKERS_H_INCLUDED
+#define GENVOICEWORKERS_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <thread>
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ // the kernel32 calls the semaphore needs, declared here so that including this
+ // doesn't bring all of windows.h along
+ extern "C"
+ {
+     struct _SECURITY_ATTRIBUTES;
+     __declspec (dllimport) void* __stdcall CreateSemaphoreW (_SECURITY_ATTRIBUTES*, long, long, const wchar_t*);
+     __declspec (dllimport) int __stdcall ReleaseSemaphore (void*, long, long*);
+     __declspec (dllimport) unsigned long __stdcall WaitForSingleObject (void*, unsigned long);
+     __declspec (dllimport) int __stdcall CloseHandle (void*);
+ }
+#else
+ #include <cerrno>
+ #include <semaphore.h>
+#endif
+
+//==============================================================================
+/**
+    Runs one job on several threads at once and waits for all of them: the
+    calling thread does the part of worker 0, the pool's threads do the rest.
+
+        audio thread:    run (job)  ->  job (0)  ... wait until all finished
+        worker threads:  job (1) ... job (N - 1)
+
+    Between jobs the workers spin for spinSeconds, as the next block is usually
+    that close, before they go to sleep on a semaphore. run() only posts to
+    workers that are asleep, so while blocks keep coming it is a couple of atomic
+    operations. It never allocates or takes a lock: posting the semaphore wakes
+    the worker without waiting for anything, unlike a WaitableEvent, whose
+    signal() locks a mutex the worker may hold.
+*/
+class GenVoiceWorkers
+{
+public:
+    //==============================================================================
+    /** Called with the context passed to run() and the worker's index. */
+    using Job = void (*) (void* context, int worker);
+
+    /** numThreads threads are started in addition to the thread calling run(). */
+    explicit GenVoiceWorkers (int numThreads)
+    {
+        for (int i = 0; i < numThreads; ++i)
+            m_Threads.add (new Worker (*this, i + 1));
+
+        for (auto* worker : m_Threads)
+            worker->startThread (10);
+    }
+
+    ~GenVoiceWorkers()
+    {
+        for (auto* worker : m_Threads)
+            worker->signalThreadShouldExit();
+
+        for (auto* worker : m_Threads)
+        {
+            worker->m_Wake.post();
+            worker->stopThread (-1);
+        }
+    }
+
+    /** The number of threads that work on a job, including the caller's. */
+    int getNumWorkers() const noexcept      { return m_Threads.size() + 1; }
+
+    /** Runs job (context, w) for every worker w and returns once all are done.
+        Only one thread may call this at a time.
+    */
+    void run (Job job, void* context) noexcept
+    {
+        if (m_Threads.isEmpty())
+        {
+            job (context, 0);
+            return;
+        }
+
+        m_Job = job;
+        m_Context = context;
+        m_NumFinished.store (0, std::memory_order_relaxed);
+        m_Generation.fetch_add (1, std::memory_order_seq_cst);
+
+        for (auto* worker : m_Threads)
+            if (worker->m_Sleeping.load (std::memory_order_seq_cst))
+                worker->m_Wake.post();
+
+        job (context, 0);
+
+        // the others started at the same time on about as much work, so spin
+        while (m_NumFinished.load (std::memory_order_acquire) < m_Threads.size())
+            std::this_thread::yield();
+    }
+
+    //==============================================================================
+    static constexpr double spinSeconds = 0.002;
+
+private:
+    //==============================================================================
+    /** The platform's counting semaphore. post() doesn't block, so the audio
+        thread may call it; wait() is for the workers.
+    */
+    class Semaphore
+    {
+    public:
+        Semaphore()
+        {
+           #if JUCE_MAC || JUCE_IOS
+            m_Semaphore = dispatch_semaphore_create (0);
+           #elif JUCE_WINDOWS
+            m_Semaphore = CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr);
+           #else
+            sem_init (&m_Semaphore, 0, 0);
+           #endif
+        }
+
+        ~Semaphore()
+        {
+           #if JUCE_MAC || JUCE_IOS
+            dispatch_release (m_Semaphore);
+           #elif JUCE_WINDOWS
+            CloseHandle (m_Semaphore);
+           #else
+            sem_destroy (&m_Semaphore);
+           #endif
+        }
+
+        void post() noexcept
+        {
+           #if JUCE_MAC || JUCE_IOS
+            dispatch_semaphore_signal (m_Semaphore);
+           #elif JUCE_WINDOWS
+            ReleaseSemaphore (m_Semaphore, 1, nullptr);
+           #else
+            sem_post (&m_Semaphore);
+           #endif
+        }
+
+        void wait() noexcept
+        {
+           #if JUCE_MAC || JUCE_IOS
+            dispatch_semaphore_wait (m_Semaphore, DISPATCH_TIME_FOREVER);
+           #elif JUCE_WINDOWS
+            WaitForSingleObject (m_Semaphore, 0xffffffff);
+           #else
+            while (sem_wait (&m_Semaphore) != 0 && errno == EINTR) {}
+           #endif
+        }
+
+    private:
+       #if JUCE_MAC || JUCE_IOS
+        dispatch_semaphore_t m_Semaphore;
+       #elif JUCE_WINDOWS
+        void* m_Semaphore;
+       #else
+        sem_t m_Semaphore;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE (Semaphore)
+    };
+
+    //==============================================================================
+    struct Worker  : public Thread
+    {
+        Worker (GenVoiceWorkers& owner, int index)
+            : Thread ("gen voice worker " + String (index)),
+              m_Owner (owner),
+              m_Index (index)
+        {
+        }
+
+        void run() override
+        {
+            // workers start before the first job, which is job 1
+            uint64 done = 0;
+
+            while (! threadShouldExit())
+            {
+                if (! waitForJob (done))
+                    continue;
+
+                done = m_Owner.m_Generation.load (std::memory_order_acquire);
+                m_Owner.m_Job (m_Owner.m_Context, m_Index);
+                m_Owner.m_NumFinished.fetch_add (1, std::memory_order_release);
+            }
+        }
+
+        /** Returns true once there is a job after the one numbered done. */
+        bool waitForJob (uint64 done)
+        {
+            const int64 spinUntil = Time::getHighResolutionTicks() + Time::secondsToHighResolutionTicks (spinSeconds);
+
+            while (Time::getHighResolutionTicks() < spinUntil)
+            {
+                if (m_Owner.m_Generation.load (std::memory_order_acquire) != done)
+                    return true;
+
+                std::this_thread::yield();
+            }
+
+            // run() looks at m_Sleeping after publishing a job, so either it
+            // posts to us or we see the job here
+            m_Sleeping.store (true, std::memory_order_seq_cst);
+
+            if (m_Owner.m_Generation.load (std::memory_order_seq_cst) == done && ! threadShouldExit())
+                m_Wake.wait();
+
+            m_Sleeping.store (false, std::memory_order_relaxed);
+            return m_Owner.m_Generation.load (std::memory_order_acquire) != done;
+        }
+
+        GenVoiceWorkers& m_Owner;
+        const int m_Index;
+
+        std::atomic<bool> m_Sleeping { false };
+        Semaphore m_Wake;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Worker)
+    };
+
+    //==============================================================================
+    OwnedArray<Worker> m_Threads;
+
+    Job m_Job = nullptr;
+    void* m_Context = nullptr;
+
+    std::atomic<uint64> m_Generation { 0 };
+    std::atomic<int> m_NumFinished { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenVoiceWorkers)
+};
+
+
+#endif  // GENVOICEWORKERS_H_INCLUDED
@@ -0,0 +1,95 @@
+/*
+  ==============================================================================
+
+    ParameterEventQueue.h
+
+    Carries timestamped gen parameter changes to the audio thread.
+
+  ==============================================================================
+*/
+
+#ifndef PARAMETEREVENTQUEUE_H_INCLUDED
+#define PARAMETEREVENTQUEUE_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+
+//==============================================================================
+/**
+    A fixed-size FIFO of parameter changes, each tagged with the sample offset
+    in the next processed block at which it should take effect.
+
+    The audio thread is the only reader and never blocks. Writers may come from
+    several threads (host automation, GUI), so pushes are serialised with a
+    spin lock that the reader never takes.
+*/
+class ParameterEventQueue
+{
+public:
+    //==============================================================================
+    struct Event
+    {
+        int index;
+        t_param value;
+        int sampleOffset;
+    };
+
+    //==============================================================================
+    explicit ParameterEventQueue (int capacity = 1024)
+        : m_Fifo (capacity)
+    {
+        m_Events.calloc (capacity);
+    }
+
+    /** Queues a change. Returns false (and drops the change) if the queue is full. */
+    bool push (int index, t_param value, int sampleOffset)
+    {
+        jassert (sampleOffset >= 0);
+
+        const SpinLock::ScopedLockType lock (m_WriteLock);
+
+        int start1, size1, start2, size2;
+        m_Fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 < 1)
+            return false;
+
+        m_Events[size1 > 0 ? start1 : start2] = { index, value, jmax (0, sampleOffset) };
+        m_Fifo.finishedWrite (1);
+        return true;
+    }
+
+    /** Reader only: looks at the oldest change without removing it. */
+    bool peek (Event& event) const
+    {
+        int start1, size1, start2, size2;
+        m_Fifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 + size2 < 1)
+            return false;
+
+        event = m_Events[size1 > 0 ? start1 : start2];
+        return true;
+    }
+
+    /** Reader only: removes the oldest change. */
+    void pop()
+    {
+        m_Fifo.finishedRead (1);
+    }
+
+    /** The number of changes waiting to be read. */
+    int getNumReady() const noexcept     { return m_Fifo.getNumReady(); }
+
+private:
+    //==============================================================================
+    AbstractFifo m_Fifo;
+    HeapBlock<Event> m_Events;
+    SpinLock m_WriteLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterEventQueue)
+};
+
+
+#endif  // PARAMETEREVENTQUEUE_H_INCLUDED
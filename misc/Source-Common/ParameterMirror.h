@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    ParameterMirror.h
+
+    Wait-free hand-off of gen parameter values to the audio thread.
+
+  ==============================================================================
+*/
+
+#ifndef PARAMETERMIRROR_H_INCLUDED
+#define PARAMETERMIRROR_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+
+#include <atomic>
+
+//==============================================================================
+/**
+    Holds the latest value of every gen parameter in an atomic, plus a bitset
+    of the parameters that changed since the audio thread last looked.
+
+    Any thread may call set(); only the audio thread calls drain(), which is
+    the one place values are written into the gen state. This keeps gen from
+    being modified while perform() is running.
+*/
+class ParameterMirror
+{
+public:
+    //==============================================================================
+    explicit ParameterMirror (int numParams)
+        : m_NumParams (numParams),
+          m_NumWords ((numParams + 31) / 32),
+          m_Values (new std::atomic<t_param>[(size_t) jmax (1, numParams)]()),
+          m_Dirty (new std::atomic<uint32>[(size_t) jmax (1, m_NumWords)]()),
+          m_AnyDirty (false)
+    {
+        jassert (m_NumParams == 0 || m_Values[0].is_lock_free());
+    }
+
+    /** Stores a value and marks it for the audio thread. Wait-free. */
+    void set (int index, t_param value) noexcept
+    {
+        jassert (isPositiveAndBelow (index, m_NumParams));
+
+        m_Values[index].store (value, std::memory_order_release);
+        m_Dirty[index >> 5].fetch_or ((uint32) 1 << (index & 31), std::memory_order_release);
+        m_AnyDirty.store (true, std::memory_order_release);
+    }
+
+    /** Stores a value without marking it, e.g. when it was read back from gen. */
+    void store (int index, t_param value) noexcept
+    {
+        jassert (isPositiveAndBelow (index, m_NumParams));
+        m_Values[index].store (value, std::memory_order_release);
+    }
+
+    /** The most recently stored value. */
+    t_param get (int index) const noexcept
+    {
+        jassert (isPositiveAndBelow (index, m_NumParams));
+        return m_Values[index].load (std::memory_order_acquire);
+    }
+
+    /** Audio thread only: calls apply (index, value) for every parameter that
+        was set since the last call, and clears the marks.
+    */
+    template <typename ApplyFunction>
+    void drain (ApplyFunction&& apply)
+    {
+        if (! m_AnyDirty.exchange (false, std::memory_order_acquire))
+            return;
+
+        for (int word = 0; word < m_NumWords; ++word)
+        {
+            uint32 bits = m_Dirty[word].exchange (0, std::memory_order_acquire);
+
+            while (bits != 0)
+            {
+                const int bit = countTrailingZeros (bits);
+                const int index = (word << 5) + bit;
+
+                apply (index, m_Values[index].load (std::memory_order_acquire));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    int getNumParameters() const noexcept    { return m_NumParams; }
+
+private:
+    //==============================================================================
+    static int countTrailingZeros (uint32 bits) noexcept
+    {
+        int n = 0;
+
+        while ((bits & 1) == 0)
+        {
+            bits >>= 1;
+            ++n;
+        }
+
+        return n;
+    }
+
+    const int m_NumParams, m_NumWords;
+    std::unique_ptr<std::atomic<t_param>[]> m_Values;
+    std::unique_ptr<std::atomic<uint32>[]> m_Dirty;
+    std::atomic<bool> m_AnyDirty;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParameterMirror)
+};
+
+
+#endif  // PARAMETERMIRROR_H_INCLUDED
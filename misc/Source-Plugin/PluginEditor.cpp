@@ -14,11 +14,16 @@
 
 //==============================================================================
 C74GenAudioProcessorEditor::C74GenAudioProcessorEditor (C74GenAudioProcessor& p)
-    : AudioProcessorEditor (&p), processor (p)
+    : AudioProcessorEditor (&p), processor (p),
+      loadOverlay (p),
+      parameterEditor (p)
 {
+    addAndMakeVisible (loadOverlay);
+    addAndMakeVisible (parameterEditor);
+
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (jmax (400, parameterEditor.getWidth()), 90 + parameterEditor.getHeight());
 }
 
 C74GenAudioProcessorEditor::~C74GenAudioProcessorEditor()
@@ -28,15 +33,76 @@ C74GenAudioProcessorEditor::~C74GenAudioProcessorEditor()
 //==============================================================================
 void C74GenAudioProcessorEditor::paint (Graphics& g)
 {
-    g.fillAll (Colours::white);
-
-    g.setColour (Colours::black);
-    g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), Justification::centred, 1);
+    g.fillAll (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
 }
 
 void C74GenAudioProcessorEditor::resized()
 {
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
+    auto bounds = getLocalBounds();
+    loadOverlay.setBounds (bounds.removeFromTop (90));
+    parameterEditor.setBounds (bounds);
+}
+
+//==============================================================================
+C74GenAudioProcessorEditor::LoadOverlay::LoadOverlay (C74GenAudioProcessor& p)
+    : processor (p)
+{
+    startTimerHz (10);
+}
+
+void C74GenAudioProcessorEditor::LoadOverlay::timerCallback()
+{
+    stats = processor.getLoadStatistics();
+    repaint();
+}
+
+void C74GenAudioProcessorEditor::LoadOverlay::mouseDown (const MouseEvent&)
+{
+    processor.resetLoadStatistics();
+}
+
+void C74GenAudioProcessorEditor::LoadOverlay::paint (Graphics& g)
+{
+    auto bounds = getLocalBounds().reduced (8, 6);
+
+    g.fillAll (Colours::black);
+    g.setFont (13.0f);
+
+    auto percent = [] (double proportion) { return String (proportion * 100.0, 1) + "%"; };
+
+    const double measured = stats.stageSeconds[GenLoadMeter::conversion] + stats.stageSeconds[GenLoadMeter::perform];
+    const double rest = jmax (0.0, stats.totalSeconds - measured);
+    auto share = [&] (double seconds) { return percent (stats.totalSeconds > 0 ? seconds / stats.totalSeconds : 0.0); };
+
+    g.setColour (stats.numOverruns > 0 ? Colours::orangered : Colours::white);
+    g.drawText ("load " + percent (stats.load) + "   worst block " + percent (stats.worstBlock)
+                  + "   at risk " + String (stats.numBlocksAtRisk) + "   overruns " + String (stats.numOverruns)
+                  + " of " + String (stats.numBlocks),
+                bounds.removeFromTop (18), Justification::centredLeft);
+
+    g.setColour (Colours::lightgrey);
+    g.drawText ("perform " + share (stats.stageSeconds[GenLoadMeter::perform])
+                  + "   conversion " + share (stats.stageSeconds[GenLoadMeter::conversion])
+                  + "   other " + share (rest),
+                bounds.removeFromTop (18), Justification::centredLeft);
+
+    // histogram of block time over deadline, 0% to 100% and over, on a log scale
+    bounds.removeFromTop (4);
+    int64 highest = 1;
+
+    for (auto count : stats.histogram)
+        highest = jmax (highest, count);
+
+    const float binWidth = bounds.getWidth() / (float) GenLoadMeter::numBins;
+    const float maxLevel = std::log1p ((float) highest);
+
+    for (int b = 0; b < GenLoadMeter::numBins; ++b)
+    {
+        const float height = bounds.getHeight() * std::log1p ((float) stats.histogram[b]) / maxLevel;
+        const bool atRisk = b >= (int) (GenLoadMeter::atRiskProportion * (GenLoadMeter::numBins - 1));
+
+        g.setColour (b == GenLoadMeter::numBins - 1 ? Colours::orangered
+                                                    : (atRisk ? Colours::orange : Colours::limegreen));
+        g.fillRect (bounds.getX() + b * binWidth + 1.0f, bounds.getBottom() - height, binWidth - 2.0f, height);
+    }
 }
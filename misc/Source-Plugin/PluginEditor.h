@@ -17,6 +17,9 @@
 
 //==============================================================================
 /**
+    c74: shown with GEN_LOAD_OVERLAY, the host's usual parameter controls under
+    a strip showing how much of the block deadline this instance takes. Clicking
+    the strip starts the counts over.
 */
 class C74GenAudioProcessorEditor  : public AudioProcessorEditor
 {
@@ -29,10 +32,35 @@ public:
     void resized() override;
 
 private:
+    //==============================================================================
+    /** Load, worst block, xrun risk, the histogram of block times and the split
+        between conversion and perform, read from the processor a few times a second.
+    */
+    class LoadOverlay  : public Component,
+                         private Timer
+    {
+    public:
+        LoadOverlay (C74GenAudioProcessor&);
+
+        void paint (Graphics&) override;
+        void mouseDown (const MouseEvent&) override;
+
+    private:
+        void timerCallback() override;
+
+        C74GenAudioProcessor& processor;
+        GenLoadMeter::Statistics stats;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadOverlay)
+    };
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     C74GenAudioProcessor& processor;
 
+    LoadOverlay loadOverlay;
+    GenericAudioProcessorEditor parameterEditor;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (C74GenAudioProcessorEditor)
 };
 
@@ -13,27 +13,67 @@
 
 //==============================================================================
 C74GenAudioProcessor::C74GenAudioProcessor()
-:m_CurrentBufferSize(0)
+// use a default samplerate and vector size here, reset it later
+:m_C74PluginState((CommonState *)C74_GENPLUGIN::create(44100, 64)),
+ m_ParameterInfo(m_C74PluginState),
+ m_Parameters(*this, nullptr, "C74GenParameters", createParameterLayout(m_ParameterInfo, m_C74PluginState)),
+ m_ParameterSmoothers((size_t)C74_GENPLUGIN::num_params()),
+ m_NumRampingParameters(0),
+ m_GenBuffers(C74_GENPLUGIN::num_inputs(), C74_GENPLUGIN::num_outputs()),
+ m_SampleAccurateAutomation(false),
+ m_MinSubBlockSize(16),
+ m_MidiInput(m_ParameterInfo, C74_GENPLUGIN::num_inputs()),
+ m_SilenceGate(C74_GENPLUGIN::num_inputs() > 0 && ! m_MidiInput.isEnabled()
+			   && GenPluginMetadata::getStreamPositionInlet(C74_GENPLUGIN::num_inputs()) < 0),
+ m_Voices(m_ParameterInfo, C74_NUM_VOICES, C74_VOICE_THREADS, C74_MPE),
+ m_StateLoader(m_C74PluginState, m_ParameterInfo),
+ m_SampleLoader(C74_GENPLUGIN::num_params()),
+ m_StreamPosition(0),
+ m_StreamPositionInlet(GenPluginMetadata::getStreamPositionInlet(C74_GENPLUGIN::num_inputs())),
+ m_NumStreamUnderruns(0)
 {
-	// use a default samplerate and vector size here, reset it later
-	m_C74PluginState = (CommonState *)C74_GENPLUGIN::create(44100, 64);
 	C74_GENPLUGIN::reset(m_C74PluginState);
 
-	m_InputBuffers = new t_sample *[C74_GENPLUGIN::num_inputs()];
-	m_OutputBuffers = new t_sample *[C74_GENPLUGIN::num_outputs()];
+	// c74: processBlock compares these raw values against what gen last received
+	m_AppliedParameterValues.malloc(jmax(1, C74_GENPLUGIN::num_params()));
+	m_ParameterRampSeconds.malloc(jmax(1, C74_GENPLUGIN::num_params()));
+	m_RampingParameters.malloc(jmax(1, C74_GENPLUGIN::num_params()));
+	m_ParameterIsRamping.calloc(jmax(1, C74_GENPLUGIN::num_params()));
 	
-	for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
-		m_InputBuffers[i] = NULL;
-	}
-	for (int i = 0; i < C74_GENPLUGIN::num_outputs(); i++) {
-		m_OutputBuffers[i] = NULL;
+	for (int i = 0; i < C74_GENPLUGIN::num_params(); i++) {
+		const String& paramID = m_ParameterInfo.getName(i);
+		
+		m_GenParameters.add(m_Parameters.getParameter(paramID));
+		m_RawParameterValues.add(m_Parameters.getRawParameterValue(paramID));
+		m_AppliedParameterValues[i] = m_RawParameterValues[i]->load();
+		
+		m_ParameterRampSeconds[i] = GenPluginMetadata::getParameterRampMs(paramID) / 1000.0;
+		m_ParameterSmoothers[(size_t)i].reset(44100, m_ParameterRampSeconds[i]);
+		m_ParameterSmoothers[(size_t)i].setCurrentAndTargetValue(m_AppliedParameterValues[i]);
 	}
 
+	m_GenBuffers.allocate(64);
+	
+	m_InPlaceInputs = new t_sample *[C74_GENPLUGIN::num_inputs()];
+	m_InPlaceOutputs = new t_sample *[C74_GENPLUGIN::num_outputs()];
+	
+	m_Voices.copyState(m_C74PluginState);
+	
+	m_StateLoader.onLoaded = [this] { triggerAsyncUpdate(); };
 }
 
 C74GenAudioProcessor::~C74GenAudioProcessor()
 {
+	// c74: the loader thread may be about to call onLoaded, so it is joined
+	// before the update it triggers is cancelled. Instances the loader still
+	// holds are destroyed along with it.
+	m_StateLoader.stop();
+	cancelPendingUpdate();
+	
 	C74_GENPLUGIN::destroy(m_C74PluginState);
+	
+	delete [] m_InPlaceInputs;
+	delete [] m_InPlaceOutputs;
 }
 
 //==============================================================================
@@ -42,47 +82,6 @@ const String C74GenAudioProcessor::getName() const
     return JucePlugin_Name;
 }
 
-int C74GenAudioProcessor::getNumParameters()
-{
-	return C74_GENPLUGIN::num_params();
-}
-
-float C74GenAudioProcessor::getParameter (int index)
-{
-	t_param value;
-	t_param min = C74_GENPLUGIN::getparametermin(m_C74PluginState, index);
-	t_param range = fabs(C74_GENPLUGIN::getparametermax(m_C74PluginState, index) - min);
-	
-	C74_GENPLUGIN::getparameter(m_C74PluginState, index, &value);
-	
-	value = (value - min) / range;
-	
-	return value;
-}
-
-void C74GenAudioProcessor::setParameter (int index, float newValue)
-{
-	t_param min = C74_GENPLUGIN::getparametermin(m_C74PluginState, index);
-	t_param range = fabs(C74_GENPLUGIN::getparametermax(m_C74PluginState, index) - min);
-	t_param value = newValue * range + min;
-	
-	C74_GENPLUGIN::setparameter(m_C74PluginState, index, value, NULL);
-}
-
-const String C74GenAudioProcessor::getParameterName (int index)
-{
-    return String(C74_GENPLUGIN::getparametername(m_C74PluginState, index));
-}
-
-const String C74GenAudioProcessor::getParameterText (int index)
-{
-	String text = String(getParameter(index));
-	text += String(" ");
-	text += String(C74_GENPLUGIN::getparameterunits(m_C74PluginState, index));
-
-	return text;
-}
-
 const String C74GenAudioProcessor::getInputChannelName (int channelIndex) const
 {
     return String (channelIndex + 1);
@@ -123,12 +122,13 @@ bool C74GenAudioProcessor::producesMidi() const
 
 bool C74GenAudioProcessor::silenceInProducesSilenceOut() const
 {
-    return false;
+	// c74: only promised when the patch's tail is known (GEN_SILENCE_TAIL_MS)
+	return m_SilenceGate.isEnabled();
 }
 
 double C74GenAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+	return m_SilenceGate.getTailSeconds();
 }
 
 int C74GenAudioProcessor::getNumPrograms()
@@ -165,7 +165,17 @@ void C74GenAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock
 	m_C74PluginState->sr = sampleRate;
 	m_C74PluginState->vs = samplesPerBlock;
 
-	assureBufferSize(samplesPerBlock);
+	m_GenBuffers.allocate(samplesPerBlock);
+	m_Voices.prepare(sampleRate, samplesPerBlock);
+	m_LoadMeter.prepare(sampleRate, samplesPerBlock);
+	m_SilenceGate.prepare(sampleRate);
+	
+	// ramps are counted in samples, so they start over at the new rate
+	for (int i = 0; i < C74_GENPLUGIN::num_params(); i++) {
+		m_ParameterSmoothers[(size_t)i].reset(sampleRate, m_ParameterRampSeconds[i]);
+		stopParameterRamp(i, m_AppliedParameterValues[i]);
+	}
+	m_NumRampingParameters = 0;
 }
 
 void C74GenAudioProcessor::releaseResources()
@@ -176,43 +186,99 @@ void C74GenAudioProcessor::releaseResources()
 
 void C74GenAudioProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
 {
-	assureBufferSize(buffer.getNumSamples());
+	const int numSamples = buffer.getNumSamples();
+	const GenLoadMeter::BlockTimer blockTimer(m_LoadMeter, numSamples);
 	
-	// fill input buffers
-	for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
-		if (i < getNumInputChannels()) {
-			for (int j = 0; j < m_CurrentBufferSize; j++) {
-				m_InputBuffers[i][j] = buffer.getReadPointer(i)[j];
+	swapInLoadedState();
+	bindPendingSamples();
+	applyParameterValues();
+	m_MidiInput.beginBlock(midiMessages);
+	const int64 streamPosition = beginStreams(numSamples);
+	
+	// c74: once the input has been silent for longer than the patch's tail,
+	// gen's output would be silent too (see GenSilenceGate)
+	if (m_SilenceGate.canSkip(buffer, getTotalNumInputChannels())) {
+		buffer.clear();
+		skipSilentBlock(numSamples);
+	} else {
+		// c74: gen runs in sub-blocks that end at queued parameter changes, at MIDI
+		// events, at ramp updates and at the block size announced in prepareToPlay so nothing is
+		// allocated here
+		for (int start = 0; start < numSamples; ) {
+			const int end = beginSubBlock(start, numSamples);
+			
+			if (m_Voices.isEnabled()) {
+				// c74: every voice runs a gen instance of its own (see GenVoiceEngine)
+				const auto renderStart = GenLoadMeter::Clock::now();
+				m_Voices.render(buffer, midiMessages, start, end - start);
+				m_LoadMeter.lap(GenLoadMeter::perform, renderStart);
+			} else {
+#ifdef GENLIB_USE_FLOAT32
+				// gen is built in single precision, so it runs directly on the host's buffer
+				performInPlace(buffer, start, end - start);
+#else
+				performConverted(buffer, start, end - start);
+#endif
 			}
-		} else {
-			memset(m_InputBuffers[i], 0, m_CurrentBufferSize *  sizeof(double));
+			start = end;
 		}
 	}
 	
-	// process audio
-	C74_GENPLUGIN::perform(m_C74PluginState,
-								  m_InputBuffers,
-								  C74_GENPLUGIN::num_inputs(),
-								  m_OutputBuffers,
-								  C74_GENPLUGIN::num_outputs(),
-								  buffer.getNumSamples());
+	flushParameterEvents();
+	endStreams(streamPosition, numSamples);
+}
 
-	// fill output buffers
-	for (int i = 0; i < getNumOutputChannels(); i++) {
-		if (i < C74_GENPLUGIN::num_outputs()) {
-			for (int j = 0; j < buffer.getNumSamples(); j++) {
-				buffer.getWritePointer(i)[j] = m_OutputBuffers[i][j];
+#ifndef GENLIB_USE_FLOAT32
+void C74GenAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+	const int numSamples = buffer.getNumSamples();
+	const GenLoadMeter::BlockTimer blockTimer(m_LoadMeter, numSamples);
+	
+	swapInLoadedState();
+	bindPendingSamples();
+	applyParameterValues();
+	m_MidiInput.beginBlock(midiMessages);
+	const int64 streamPosition = beginStreams(numSamples);
+	
+	if (m_SilenceGate.canSkip(buffer, getTotalNumInputChannels())) {
+		buffer.clear();
+		skipSilentBlock(numSamples);
+	} else {
+		// c74: the host delivers doubles, which is what gen processes, so skip the
+		// conversion buffers entirely
+		for (int start = 0; start < numSamples; ) {
+			const int end = beginSubBlock(start, numSamples);
+			
+			if (m_Voices.isEnabled()) {
+				const auto renderStart = GenLoadMeter::Clock::now();
+				m_Voices.render(buffer, midiMessages, start, end - start);
+				m_LoadMeter.lap(GenLoadMeter::perform, renderStart);
+			} else {
+				performInPlace(buffer, start, end - start);
 			}
-		} else {
-			buffer.clear (i, 0, buffer.getNumSamples());
+			start = end;
 		}
 	}
+	
+	flushParameterEvents();
+	endStreams(streamPosition, numSamples);
+}
+#endif
+
+bool C74GenAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+#ifdef GENLIB_USE_FLOAT32
+	return false;
+#else
+	return true;
+#endif
 }
 
 //==============================================================================
 bool C74GenAudioProcessor::hasEditor() const
 {
-    return false; // (change this to true if you choose to supply an editor)
+	// c74: without GEN_LOAD_OVERLAY the host shows its own parameter controls
+	return C74_LOAD_OVERLAY != 0;
 }
 
 AudioProcessorEditor* C74GenAudioProcessor::createEditor()
@@ -227,21 +293,105 @@ void C74GenAudioProcessor::getStateInformation (MemoryBlock& destData)
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
 	
-	char *state;
-	size_t statesize = C74_GENPLUGIN::getstatesize(m_C74PluginState);
-	state = (char *)malloc(sizeof(char) * statesize);
+	// c74: a state that is still being restored is saved as what it will be
+	m_StateLoader.waitUntilLoaded();
+	handleUpdateNowIfNeeded();
 	
-	C74_GENPLUGIN::getstate(m_C74PluginState, state);
-	destData.replaceWith(state, sizeof(char) * statesize);
-
-	if (state) free(state);
+	// gen's state is written straight into destData (see GenStateFormat), with
+	// the parameter values the host sees rather than the ones gen last got.
+	// When compressed, only what changed since the last save is compressed again.
+	GenStateFormat::write(destData, m_StateLoader.getLatestState(), m_ParameterInfo,
+						  [this] (int index) { return (t_param)m_RawParameterValues[index]->load(); },
+						  C74_COMPRESS_STATE ? &m_StateSnapshot : nullptr);
 }
 
 void C74GenAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
-	C74_GENPLUGIN::setstate(m_C74PluginState, (const char *)data);
+	
+	// c74: gen may take a while to parse a large state, so it is restored into
+	// a new instance in the background which processBlock then switches to.
+	// States saved by earlier versions hold gen's JSON and are still accepted.
+	if (sizeInBytes <= 0)
+		return;
+	
+	m_StateLoader.load(data, (size_t)sizeInBytes, getSampleRate(), getBlockSize());
+}
+
+//==============================================================================
+AudioProcessorValueTreeState& C74GenAudioProcessor::getParameters()
+{
+	return m_Parameters;
+}
+
+void C74GenAudioProcessor::setSampleAccurateAutomation (bool shouldBeEnabled)
+{
+	m_SampleAccurateAutomation = shouldBeEnabled;
+}
+
+bool C74GenAudioProcessor::isSampleAccurateAutomation() const
+{
+	return m_SampleAccurateAutomation;
+}
+
+void C74GenAudioProcessor::setMinimumSubBlockSize (int numSamples)
+{
+	m_MinSubBlockSize = jmax(1, numSamples);
+}
+
+int C74GenAudioProcessor::getMinimumSubBlockSize() const
+{
+	return m_MinSubBlockSize;
+}
+
+void C74GenAudioProcessor::setParameterAtSample (int index, float newValue, int sampleOffset)
+{
+	t_param value = m_ParameterInfo.denormalise(index, newValue);
+	
+	if (! m_ParameterEvents.push(index, value, sampleOffset)) {
+		// the queue is full, so at least apply the change at the top of the next
+		// block, where applyParameterValues finds the raw value moved; like a
+		// queued change, the host isn't told
+		m_GenParameters[index]->setValue(newValue);
+		m_RawParameterValues[index]->store((float)value);
+	}
+}
+
+void C74GenAudioProcessor::loadSample (int index, const File& file, bool shared)
+{
+	m_SampleLoader.load(index, file, shared);
+}
+
+File C74GenAudioProcessor::getSampleFile (int index) const
+{
+	return m_SampleLoader.getFile(index);
+}
+
+void C74GenAudioProcessor::streamSample (int index, const File& file, double windowSeconds)
+{
+	const double sampleRate = getSampleRate() > 0 ? getSampleRate() : 44100;
+	m_SampleLoader.stream(index, file, (int)(windowSeconds * sampleRate));
+}
+
+GenSamplePool::Statistics C74GenAudioProcessor::getSamplePoolStatistics()
+{
+	return SharedResourcePointer<GenSamplePool>()->getStatistics();
+}
+
+int64 C74GenAudioProcessor::getNumStreamUnderruns() const
+{
+	return m_NumStreamUnderruns.load();
+}
+
+GenLoadMeter::Statistics C74GenAudioProcessor::getLoadStatistics() const
+{
+	return m_LoadMeter.getStatistics();
+}
+
+void C74GenAudioProcessor::resetLoadStatistics()
+{
+	m_LoadMeter.resetStatistics();
 }
 
 //==============================================================================
@@ -254,18 +404,324 @@ AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 //==============================================================================
 // C74 added methods
 
-void C74GenAudioProcessor::assureBufferSize(long bufferSize)
+#ifndef GENLIB_USE_FLOAT32
+void C74GenAudioProcessor::performConverted(AudioSampleBuffer& buffer, int startSample, int numSamples)
 {
-	if (bufferSize > m_CurrentBufferSize) {
-		for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
-			if (m_InputBuffers[i]) delete m_InputBuffers[i];
-			m_InputBuffers[i] = new t_sample[bufferSize];
+	t_sample **inputs = m_GenBuffers.getInputs();
+	t_sample **outputs = m_GenBuffers.getOutputs();
+	auto lapStart = GenLoadMeter::Clock::now();
+	
+	// fill input buffers
+	for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
+		if (m_MidiInput.drivesInlet(i)) {
+			FloatVectorOperations::fill(inputs[i], m_MidiInput.getInletValue(i), numSamples);
+		} else if (i == m_StreamPositionInlet) {
+			GenStreamingBuffer::fillPositions(inputs[i], m_StreamPosition + startSample, numSamples);
+		} else if (i < getTotalNumInputChannels()) {
+			FloatVectorOperations::convert(inputs[i], buffer.getReadPointer(i, startSample), numSamples);
+		} else {
+			FloatVectorOperations::clear(inputs[i], numSamples);
 		}
-		for (int i = 0; i < C74_GENPLUGIN::num_outputs(); i++) {
-			if (m_OutputBuffers[i]) delete m_OutputBuffers[i];
-			m_OutputBuffers[i] = new t_sample[bufferSize];
+	}
+	
+	lapStart = m_LoadMeter.lap(GenLoadMeter::conversion, lapStart);
+	
+	// process audio
+	C74_GENPLUGIN::perform(m_C74PluginState,
+								  inputs,
+								  C74_GENPLUGIN::num_inputs(),
+								  outputs,
+								  C74_GENPLUGIN::num_outputs(),
+								  numSamples);
+	lapStart = m_LoadMeter.lap(GenLoadMeter::perform, lapStart);
+
+	// fill output buffers
+	for (int i = 0; i < getTotalNumOutputChannels(); i++) {
+		if (i < C74_GENPLUGIN::num_outputs()) {
+			FloatVectorOperations::convert(buffer.getWritePointer(i, startSample), outputs[i], numSamples);
+		} else {
+			buffer.clear (i, startSample, numSamples);
+		}
+	}
+	m_LoadMeter.lap(GenLoadMeter::conversion, lapStart);
+}
+#endif
+
+void C74GenAudioProcessor::performInPlace(AudioBuffer<t_sample>& buffer, int startSample, int numSamples)
+{
+	const int numHostInputs = getTotalNumInputChannels();
+	const int numHostOutputs = getTotalNumOutputChannels();
+	auto lapStart = GenLoadMeter::Clock::now();
+	
+	// gen reads all inputs of a frame before it writes that frame's outputs, so
+	// its inputs and outputs may share host channels. Inputs the host doesn't
+	// provide read silence from scratch memory rather than a host channel that
+	// only carries output, and outputs the host doesn't provide are discarded.
+	// Inlets MIDI drives read its value from scratch memory as well, and so does
+	// the stream position inlet.
+	for (int i = 0; i < C74_GENPLUGIN::num_inputs(); i++) {
+		if (m_MidiInput.drivesInlet(i)) {
+			m_InPlaceInputs[i] = m_GenBuffers.getInputs()[i];
+			FloatVectorOperations::fill(m_InPlaceInputs[i], m_MidiInput.getInletValue(i), numSamples);
+		} else if (i == m_StreamPositionInlet) {
+			m_InPlaceInputs[i] = m_GenBuffers.getInputs()[i];
+			GenStreamingBuffer::fillPositions(m_InPlaceInputs[i], m_StreamPosition + startSample, numSamples);
+		} else if (i < numHostInputs) {
+			m_InPlaceInputs[i] = buffer.getWritePointer(i, startSample);
+		} else {
+			m_InPlaceInputs[i] = m_GenBuffers.getInputs()[i];
+			FloatVectorOperations::clear(m_InPlaceInputs[i], numSamples);
+		}
+	}
+	for (int i = 0; i < C74_GENPLUGIN::num_outputs(); i++) {
+		m_InPlaceOutputs[i] = (i < numHostOutputs) ? buffer.getWritePointer(i, startSample) : m_GenBuffers.getOutputs()[i];
+	}
+	
+	lapStart = m_LoadMeter.lap(GenLoadMeter::conversion, lapStart);
+	
+	// process audio
+	C74_GENPLUGIN::perform(m_C74PluginState,
+								  m_InPlaceInputs,
+								  C74_GENPLUGIN::num_inputs(),
+								  m_InPlaceOutputs,
+								  C74_GENPLUGIN::num_outputs(),
+								  numSamples);
+	lapStart = m_LoadMeter.lap(GenLoadMeter::perform, lapStart);
+	
+	// silence host outputs gen doesn't drive
+	for (int i = C74_GENPLUGIN::num_outputs(); i < numHostOutputs; i++) {
+		buffer.clear (i, startSample, numSamples);
+	}
+	m_LoadMeter.lap(GenLoadMeter::conversion, lapStart);
+}
+
+AudioProcessorValueTreeState::ParameterLayout C74GenAudioProcessor::createParameterLayout(const GenParameterTable& info, CommonState *state)
+{
+	AudioProcessorValueTreeState::ParameterLayout layout;
+	
+	for (int i = 0; i < info.size(); i++) {
+		// c74: JUCE asserts on an empty range, which a gen parameter with min >= max
+		// (a constant, or its bounds swapped) would give it
+		const float min = (float)info.getMin(i);
+		const float max = jmax((float)info.getMax(i), min + jmax(std::abs(min), 1.0f) * 1.0e-6f);
+		t_param value;
+		
+		C74_GENPLUGIN::getparameter(state, i, &value);
+		
+		layout.add(std::make_unique<AudioParameterFloat>(info.getName(i), info.getName(i),
+														 NormalisableRange<float>(min, max),
+														 jlimit(min, max, (float)value),
+														 info.getUnits(i)));
+	}
+	
+	return layout;
+}
+
+void C74GenAudioProcessor::applyParameterValues()
+{
+	// only parameters whose raw value moved since the last block reach gen
+	for (int i = 0; i < C74_GENPLUGIN::num_params(); i++) {
+		const float value = m_RawParameterValues.getUnchecked(i)->load(std::memory_order_relaxed);
+		
+		if (value != m_AppliedParameterValues[i]) {
+			m_AppliedParameterValues[i] = value;
+			
+			if (m_ParameterRampSeconds[i] > 0) {
+				// glide there, advanceParameterRamps feeds gen from here on
+				m_ParameterSmoothers[(size_t)i].setTargetValue(value);
+				
+				if (! m_ParameterIsRamping[i] && m_ParameterSmoothers[(size_t)i].isSmoothing()) {
+					m_ParameterIsRamping[i] = true;
+					m_RampingParameters[m_NumRampingParameters++] = i;
+				}
+			} else {
+				setGenParameter(i, value);
+			}
+		}
+	}
+}
+
+void C74GenAudioProcessor::syncParametersFromGen()
+{
+	// the values of the instance restored last, which the audio thread may not
+	// have switched to yet
+	const Array<t_param> values = m_StateLoader.getLoadedParameterValues();
+	
+	for (int i = 0; i < values.size(); i++) {
+		m_GenParameters[i]->setValueNotifyingHost((float)m_ParameterInfo.normalise(i, values[i]));
+	}
+}
+
+void C74GenAudioProcessor::handleAsyncUpdate()
+{
+	syncParametersFromGen();
+}
+
+void C74GenAudioProcessor::swapInLoadedState()
+{
+	CommonState *loaded = m_StateLoader.takeLoadedState();
+	
+	if (loaded == NULL)
+		return;
+	
+	loaded->sr = m_C74PluginState->sr;
+	loaded->vs = m_C74PluginState->vs;
+	
+	m_StateLoader.retire(m_C74PluginState);
+	m_C74PluginState = loaded;
+	m_SampleLoader.bindAll(loaded);
+	
+	// voices take the restored parameters and Data, the notes they play carry on
+	m_Voices.copyState(loaded);
+	
+	// the new instance starts at its saved values: ramps in progress end, and
+	// ones started once the parameters catch up begin from those values
+	for (int i = 0; i < C74_GENPLUGIN::num_params(); i++) {
+		t_param value;
+		C74_GENPLUGIN::getparameter(loaded, i, &value);
+		m_ParameterSmoothers[(size_t)i].setCurrentAndTargetValue((float)value);
+		m_ParameterIsRamping[i] = false;
+	}
+	m_NumRampingParameters = 0;
+}
+
+int64 C74GenAudioProcessor::beginStreams(int numSamples)
+{
+	if (! m_SampleLoader.hasStreams() && m_StreamPositionInlet < 0)
+		return 0;
+	
+	// c74: streams follow the host's transport, or just keep going without one
+	AudioPlayHead::CurrentPositionInfo position;
+	AudioPlayHead *playHead = getPlayHead();
+	
+	if (playHead != NULL && playHead->getCurrentPosition(position)) {
+		m_StreamPosition = jmax((int64)0, position.timeInSamples);
+	}
+	
+	if (const int numUnderruns = m_SampleLoader.beginStreams(m_StreamPosition, numSamples)) {
+		m_NumStreamUnderruns += numUnderruns;
+	}
+	
+	m_Voices.setStreamPosition(m_StreamPosition);
+	return m_StreamPosition;
+}
+
+void C74GenAudioProcessor::endStreams(int64 position, int numSamples)
+{
+	if (! m_SampleLoader.hasStreams() && m_StreamPositionInlet < 0)
+		return;
+	
+	m_StreamPosition = position + numSamples;
+	m_SampleLoader.endStreams(m_StreamPosition);
+}
+
+void C74GenAudioProcessor::bindPendingSamples()
+{
+	if (m_SampleLoader.bindPending(m_C74PluginState)) {
+		for (int v = 0; v < m_Voices.getNumVoices(); v++) {
+			m_SampleLoader.bindAll(m_Voices.getVoiceState(v));
+		}
+	}
+}
+
+void C74GenAudioProcessor::setGenParameter(int index, t_param value)
+{
+	C74_GENPLUGIN::setparameter(m_C74PluginState, index, value, NULL);
+	m_Voices.setParameter(index, value);
+}
+
+int C74GenAudioProcessor::beginSubBlock(int startSample, int numSamples)
+{
+	// changes falling inside the minimum sub-block size are applied right away,
+	// and all of them are when sub-blocks are switched off
+	const int due = m_SampleAccurateAutomation ? startSample + m_MinSubBlockSize : std::numeric_limits<int>::max();
+	int end = jmin(numSamples, startSample + m_GenBuffers.getMaxBlockSize());
+	
+	ParameterEventQueue::Event event;
+	while (m_ParameterEvents.peek(event)) {
+		if (event.sampleOffset >= due) {
+			end = jmin(end, event.sampleOffset);
+			break;
 		}
 		
-		m_CurrentBufferSize = bufferSize;
+		applyParameterEvent(event);
+		m_ParameterEvents.pop();
+	}
+	
+	// MIDI always splits gen's perform, at most every minimum sub-block size;
+	// voices get their notes from the synthesiser instead
+	if (m_MidiInput.isEnabled() && ! m_Voices.isEnabled()) {
+		const int nextEvent = m_MidiInput.applyEventsBefore(startSample + m_MinSubBlockSize,
+															[this] (int index, t_param value) { stopParameterRamp(index, value); });
+		end = jmin(end, nextEvent);
+	}
+	
+	// while anything ramps, gen gets a fresh value every rampUpdateInterval samples
+	if (m_NumRampingParameters > 0) {
+		end = jmin(end, startSample + rampUpdateInterval);
+		advanceParameterRamps(end - startSample);
+	}
+	
+	return end;
+}
+
+void C74GenAudioProcessor::advanceParameterRamps(int numSamples)
+{
+	for (int k = 0; k < m_NumRampingParameters; ) {
+		const int i = m_RampingParameters[k];
+		SmoothedValue<float>& smoother = m_ParameterSmoothers[(size_t)i];
+		
+		if (smoother.isSmoothing()) {
+			// hand gen the value the ramp reaches by the end of this sub-block
+			setGenParameter(i, smoother.skip(numSamples));
+		}
+		
+		if (smoother.isSmoothing()) {
+			k++;
+		} else {
+			m_ParameterIsRamping[i] = false;
+			m_RampingParameters[k] = m_RampingParameters[--m_NumRampingParameters];
+		}
+	}
+}
+
+void C74GenAudioProcessor::applyParameterEvent(const ParameterEventQueue::Event& event)
+{
+	// c74: the parameter takes the value gen gets, so the host and editor read
+	// it back and applyParameterValues doesn't send it again next block
+	const float value = (float)event.value;
+	
+	m_GenParameters[event.index]->setValue((float)m_ParameterInfo.normalise(event.index, event.value));
+	m_RawParameterValues[event.index]->store(value, std::memory_order_relaxed);
+	m_AppliedParameterValues[event.index] = value;
+	
+	stopParameterRamp(event.index, event.value);
+}
+
+void C74GenAudioProcessor::stopParameterRamp(int index, t_param value)
+{
+	// jump straight to the value, a running ramp ends at the next advance
+	m_ParameterSmoothers[(size_t)index].setCurrentAndTargetValue((float)value);
+	setGenParameter(index, value);
+}
+
+void C74GenAudioProcessor::skipSilentBlock(int numSamples)
+{
+	// gen doesn't run, but ramps still end where they would have, so gen has
+	// the right values when the input returns; queued changes are applied by
+	// flushParameterEvents
+	if (m_NumRampingParameters > 0) {
+		advanceParameterRamps(numSamples);
+	}
+}
+
+void C74GenAudioProcessor::flushParameterEvents()
+{
+	// whatever is left lies beyond this block, or arrived while it was processed;
+	// only take what is there now so a busy writer can't keep us here
+	ParameterEventQueue::Event event;
+	for (int i = m_ParameterEvents.getNumReady(); i > 0 && m_ParameterEvents.peek(event); i--) {
+		applyParameterEvent(event);
+		m_ParameterEvents.pop();
 	}
 }
@@ -14,11 +14,23 @@
 #include <JuceHeader.h>
 
 #include "C74_GENPLUGIN.h"
+#include "GenBufferArena.h"
+#include "ParameterEventQueue.h"
+#include "GenPluginMetadata.h"
+#include "GenParameterTable.h"
+#include "GenStateFormat.h"
+#include "GenStateLoader.h"
+#include "GenSampleLoader.h"
+#include "GenMidiInput.h"
+#include "GenVoiceEngine.h"
+#include "GenLoadMeter.h"
+#include "GenSilenceGate.h"
 
 //==============================================================================
 /**
 */
-class C74GenAudioProcessor  : public AudioProcessor
+class C74GenAudioProcessor  : public AudioProcessor,
+                              private AsyncUpdater
 {
 public:
     //==============================================================================
@@ -30,6 +42,10 @@ public:
     void releaseResources() override;
 
     void processBlock (AudioSampleBuffer&, MidiBuffer&) override;
+   #ifndef GENLIB_USE_FLOAT32
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+   #endif
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     AudioProcessorEditor* createEditor() override;
@@ -38,13 +54,6 @@ public:
     //==============================================================================
     const String getName() const override;
 
-    int getNumParameters() override;
-    float getParameter (int index) override;
-    void setParameter (int index, float newValue) override;
-
-    const String getParameterName (int index) override;
-    const String getParameterText (int index) override;
-
     const String getInputChannelName (int channelIndex) const override;
     const String getOutputChannelName (int channelIndex) const override;
     bool isInputChannelStereoPair (int index) const override;
@@ -66,10 +75,97 @@ public:
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    // c74: one AudioParameterFloat per gen parameter, with the gen parameter's
+    // name as its ID
+    AudioProcessorValueTreeState& getParameters();
+
+    // c74: sample-accurate automation. While enabled, processBlock splits gen's
+    // perform at the sample each change queued by setParameterAtSample applies to;
+    // otherwise queued changes are applied at the start of the block.
+    void setSampleAccurateAutomation (bool shouldBeEnabled);
+    bool isSampleAccurateAutomation() const;
+
+    // changes less than this many samples apart are applied together
+    void setMinimumSubBlockSize (int numSamples);
+    int getMinimumSubBlockSize() const;
+
+    // queues a normalised value to apply sampleOffset samples into the next block.
+    // Once applied, the parameter reads back the new value, but the host isn't
+    // notified, so it's meant for modulation rather than recording automation.
+    // Changes are applied in the order they're queued, so queue them in order of
+    // sampleOffset: one queued after a later one waits for it.
+    void setParameterAtSample (int index, float newValue, int sampleOffset);
+
+    // c74: reads an audio file in the background and binds it to the gen buffer~
+    // or Data parameter at index once it's ready. Shared files are mapped from
+    // GenSamplePool, one copy for every instance, which all see what it writes.
+    void loadSample (int index, const File& file, bool shared = false);
+    File getSampleFile (int index) const;
+
+    // c74: binds a window of the file to the gen buffer~ or Data parameter at
+    // index instead, which moves along with the host's playhead: file frame f is
+    // at index f % dim, so the patch reads it at (position % dim), where position
+    // arrives on the inlet named "stream_position" in the metadata
+    void streamSample (int index, const File& file, double windowSeconds = 10.0);
+
+    // hits, mapped and resident bytes and page faults of the shared sample pool
+    static GenSamplePool::Statistics getSamplePoolStatistics();
+
+    // blocks in which a streamed buffer didn't have the frames gen needed yet
+    int64 getNumStreamUnderruns() const;
+
+    // c74: how much of each block's deadline processBlock takes, with the time
+    // spent converting buffers and in gen's perform; safe to call from any thread
+    GenLoadMeter::Statistics getLoadStatistics() const;
+    void resetLoadStatistics();
+
 protected:
 	// c74: since Juce does float sample processing and Gen offers double sample
-	// processing, we need to go through input and output buffers
-	void assureBufferSize(long bufferSize);
+	// processing, we need to go through input and output buffers (unless gen is
+	// built with GENLIB_USE_FLOAT32)
+	void performConverted(AudioSampleBuffer& buffer, int startSample, int numSamples);
+	
+	// c74: when the host buffer already holds t_sample data, gen runs directly on
+	// the host's channels and only missing channels go through m_GenBuffers
+	void performInPlace(AudioBuffer<t_sample>& buffer, int startSample, int numSamples);
+	
+	static AudioProcessorValueTreeState::ParameterLayout createParameterLayout(const GenParameterTable& info, CommonState *state);
+	
+	// c74: writes parameter values that changed since the last block into the
+	// gen state; only ever called on the audio thread
+	void applyParameterValues();
+	
+	// c74: updates the parameters after gen's values changed behind their back
+	void syncParametersFromGen();
+	void handleAsyncUpdate() override;
+	
+	// c74: sets a parameter on the gen instance and on every voice
+	void setGenParameter(int index, t_param value);
+	
+	// c74: binds loaded audio files to the gen instance and every voice
+	void bindPendingSamples();
+	
+	// c74: switches to an instance m_StateLoader restored, if there is one; only
+	// ever called on the audio thread
+	void swapInLoadedState();
+	
+	// c74: applies the queued parameter changes and MIDI events that are due at
+	// startSample, moves ramping parameters on and returns where the sub-block
+	// has to end
+	int beginSubBlock(int startSample, int numSamples);
+	void advanceParameterRamps(int numSamples);
+	void stopParameterRamp(int index, t_param value);
+	void applyParameterEvent(const ParameterEventQueue::Event& event);
+	void flushParameterEvents();
+	
+	// c74: stands in for the sub-blocks while the silence gate skips gen
+	void skipSilentBlock(int numSamples);
+	
+	// c74: tells the streamed buffers where gen reads this block, which is where
+	// the block starts
+	int64 beginStreams(int numSamples);
+	void endStreams(int64 position, int numSamples);
 	
 private:
     //==============================================================================
@@ -77,9 +173,60 @@ private:
 	
 	CommonState				*m_C74PluginState;
 	
-	long					m_CurrentBufferSize;
-	t_sample				**m_InputBuffers;
-	t_sample				**m_OutputBuffers;
+	// names, units and ranges, read from gen once
+	GenParameterTable				m_ParameterInfo;
+	
+	AudioProcessorValueTreeState	m_Parameters;
+	Array<RangedAudioParameter *>	m_GenParameters;
+	Array<std::atomic<float> *>		m_RawParameterValues;
+	HeapBlock<float>				m_AppliedParameterValues;
+	
+	// c74: parameters with a ramp time (see GenPluginMetadata) glide to new values;
+	// only the ones currently ramping are visited on the audio thread
+	std::vector<SmoothedValue<float>>	m_ParameterSmoothers;
+	HeapBlock<double>				m_ParameterRampSeconds;
+	HeapBlock<int>					m_RampingParameters;
+	HeapBlock<bool>					m_ParameterIsRamping;
+	int								m_NumRampingParameters;
+	
+	// while a parameter ramps, gen receives a new value this often (in samples)
+	static constexpr int			rampUpdateInterval = 32;
+	
+	// sized in prepareToPlay, never reallocated on the audio thread
+	GenBufferArena			m_GenBuffers;
+	
+	t_sample				**m_InPlaceInputs;
+	t_sample				**m_InPlaceOutputs;
+	
+	ParameterEventQueue		m_ParameterEvents;
+	std::atomic<bool>		m_SampleAccurateAutomation;
+	std::atomic<int>		m_MinSubBlockSize;
+	
+	// note, controller and pitch bend values for the parameters and inlets they're mapped to
+	GenMidiInput			m_MidiInput;
+	
+	// skips gen once the input has been silent for longer than the tail
+	GenSilenceGate			m_SilenceGate;
+	
+	// one gen instance per voice when built with GEN_VOICES
+	GenVoiceEngine			m_Voices;
+	
+	// the last saved state, compressed, to patch on the next save
+	GenStateSnapshot		m_StateSnapshot;
+	
+	// restores saved states into fresh gen instances in the background
+	GenStateLoader			m_StateLoader;
+	
+	// audio files for gen's buffer~ and Data parameters
+	GenSampleLoader			m_SampleLoader;
+	
+	// the playhead when the host has none, in samples, and the inlet it goes to
+	int64					m_StreamPosition;
+	const int				m_StreamPositionInlet;
+	std::atomic<int64>		m_NumStreamUnderruns;
+	
+	// times every block against its deadline
+	GenLoadMeter			m_LoadMeter;
 };
 
 
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    GenBatchRenderer.h
+
+    Renders a manifest of jobs through the exported gen patch, several at once.
+
+  ==============================================================================
+*/
+
+#ifndef GENBATCHRENDERER_H_INCLUDED
+#define GENBATCHRENDERER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "GenOfflineRenderer.h"
+
+#include <atomic>
+
+//==============================================================================
+/**
+    Runs the jobs of a manifest on a ThreadPool, each with a GenOfflineRenderer
+    and gen instance of its own. All jobs share one I/O thread that reads their
+    inputs ahead and writes their outputs behind, so the pool's threads spend
+    their time in perform() rather than waiting for the disk.
+
+    The manifest is a JSON list of jobs, or an object with one under "jobs".
+    Each job takes the keys input, output, automation, block_size, sample_rate,
+    length, tail and bits; keys it leaves out come from the defaults, and
+    relative paths are relative to the manifest. As jobs run at once, no two
+    may write the same file, including the temporary file each writes first:
+
+        { "jobs": [ { "input": "dry/01.wav", "output": "wet/01.flac", "tail": 2 },
+                    { "input": "dry/02.wav", "output": "wet/02.flac" } ] }
+*/
+class GenBatchRenderer
+{
+public:
+    //==============================================================================
+    struct Job
+    {
+        GenOfflineRenderer::Settings settings;
+        GenOfflineRenderer::Stats stats;
+        Result result { Result::ok() };
+    };
+
+    /** Renders numThreads jobs at a time. */
+    explicit GenBatchRenderer (int numThreads)
+        : m_Pool (jmax (1, numThreads)),
+          m_IOThread ("gen render io")
+    {
+        m_IOThread.startThread (6);
+    }
+
+    ~GenBatchRenderer()
+    {
+        m_Pool.removeAllJobs (true, -1);
+        m_IOThread.stopThread (-1);
+    }
+
+    //==============================================================================
+    /** Reads the jobs of a manifest, replacing any read before. If the manifest
+        isn't valid as a whole, no jobs are kept.
+    */
+    Result loadManifest (const File& manifest, const GenOfflineRenderer::Settings& defaults)
+    {
+        m_Jobs.clear();
+
+        var json;
+        const Result parsed = JSON::parse (manifest.loadFileAsString(), json);
+
+        if (parsed.failed())
+            return Result::fail (manifest.getFullPathName() + ": " + parsed.getErrorMessage());
+
+        const var& list = json.isArray() ? json : json["jobs"];
+
+        if (! list.isArray())
+            return Result::fail (manifest.getFullPathName() + " has no list of jobs");
+
+        const File directory (manifest.getParentDirectory());
+        OwnedArray<Job> jobs;
+        Array<File> written;
+
+        for (auto& entry : *list.getArray())
+        {
+            auto* job = jobs.add (new Job());
+            auto& settings = job->settings;
+            settings = defaults;
+
+            if (! entry.isObject() || entry["output"].toString().isEmpty())
+                return Result::fail ("Job " + String (jobs.size()) + " has no output");
+
+            settings.output = directory.getChildFile (entry["output"].toString());
+
+            for (auto& file : { settings.output, GenOfflineRenderer::getTemporaryFile (settings.output) })
+            {
+                if (written.contains (file))
+                    return Result::fail ("Job " + String (jobs.size()) + " writes " + file.getFullPathName()
+                                           + ", which another job writes too");
+
+                written.add (file);
+            }
+
+            if (entry.hasProperty ("input"))          settings.input = directory.getChildFile (entry["input"].toString());
+            if (entry.hasProperty ("automation"))     settings.automation = directory.getChildFile (entry["automation"].toString());
+            if (entry.hasProperty ("block_size"))     settings.blockSize = (int) entry["block_size"];
+            if (entry.hasProperty ("sample_rate"))    settings.sampleRate = (double) entry["sample_rate"];
+            if (entry.hasProperty ("length"))         settings.lengthSeconds = (double) entry["length"];
+            if (entry.hasProperty ("tail"))           settings.tailSeconds = (double) entry["tail"];
+            if (entry.hasProperty ("bits"))           settings.bitsPerSample = (int) entry["bits"];
+        }
+
+        m_Jobs.swapWith (jobs);
+        return Result::ok();
+    }
+
+    int getNumJobs() const noexcept                 { return m_Jobs.size(); }
+    const Job& getJob (int index) const noexcept    { return *m_Jobs.getUnchecked (index); }
+
+    //==============================================================================
+    /** Renders every job and returns once all are done. jobFinished (const Job&)
+        is called as each one finishes, from the thread that rendered it, but
+        never for two jobs at once. Returns the number of jobs that failed.
+    */
+    template <typename JobFinishedFunction>
+    int renderAll (JobFinishedFunction&& jobFinished)
+    {
+        m_NumRemaining = m_Jobs.size();
+        m_AllFinished.reset();
+
+        for (auto* job : m_Jobs)
+        {
+            m_Pool.addJob ([this, job, &jobFinished]
+            {
+                GenOfflineRenderer renderer (&m_IOThread);
+                job->result = renderer.render (job->settings, job->stats);
+
+                {
+                    const ScopedLock sl (m_CallbackLock);
+                    jobFinished (*job);
+                }
+
+                if (--m_NumRemaining == 0)
+                    m_AllFinished.signal();
+            });
+        }
+
+        if (! m_Jobs.isEmpty())
+            m_AllFinished.wait();
+
+        int numFailed = 0;
+
+        for (auto* job : m_Jobs)
+            numFailed += job->result.failed() ? 1 : 0;
+
+        return numFailed;
+    }
+
+private:
+    //==============================================================================
+    ThreadPool m_Pool;
+    TimeSliceThread m_IOThread;
+    OwnedArray<Job> m_Jobs;
+
+    CriticalSection m_CallbackLock;
+    WaitableEvent m_AllFinished;
+    std::atomic<int> m_NumRemaining { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenBatchRenderer)
+};
+
+
+#endif  // GENBATCHRENDERER_H_INCLUDED
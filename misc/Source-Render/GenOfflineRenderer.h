@@ -0,0 +1,561 @@
+/*
+  ==============================================================================
+
+    GenOfflineRenderer.h
+
+    Renders audio files through the exported gen patch without a host.
+
+  ==============================================================================
+*/
+
+#ifndef GENOFFLINERENDERER_H_INCLUDED
+#define GENOFFLINERENDERER_H_INCLUDED
+
+#include <JuceHeader.h>
+
+#include "C74_GENPLUGIN.h"
+#include "GenBufferArena.h"
+#include "GenParameterTable.h"
+
+#include <atomic>
+
+//==============================================================================
+/**
+    Parameter changes at given times, read from a JSON or CSV file. Values are
+    in the parameter's own range and hold until the next change.
+
+    JSON maps parameter names (or indices) to either a value, set from the
+    start, or a list of [seconds, value] pairs:
+
+        { "cutoff": [[0, 200], [1.5, 800]], "mix": 0.3 }
+
+    CSV has one "seconds,parameter,value" change per line; lines that don't
+    start with a number, like a header, are skipped.
+*/
+class GenAutomation
+{
+public:
+    //==============================================================================
+    struct Point
+    {
+        double seconds;
+        int parameter;
+        t_param value;
+    };
+
+    /** Reads the file, replacing any points read before. */
+    Result load (const File& file, const GenParameterTable& info)
+    {
+        m_Points.clearQuick();
+
+        if (! file.existsAsFile())
+            return Result::fail ("Can't find automation file " + file.getFullPathName());
+
+        const Result result = file.hasFileExtension ("csv") ? parseCsv (file.loadFileAsString(), info)
+                                                            : parseJson (file.loadFileAsString(), info);
+
+        std::stable_sort (m_Points.begin(), m_Points.end(),
+                          [] (const Point& a, const Point& b) { return a.seconds < b.seconds; });
+
+        return result;
+    }
+
+    /** All changes, in the order they happen. */
+    const Array<Point>& getPoints() const noexcept      { return m_Points; }
+
+private:
+    //==============================================================================
+    Result parseJson (const String& text, const GenParameterTable& info)
+    {
+        var json;
+        const Result parsed = JSON::parse (text, json);
+
+        if (parsed.failed())
+            return parsed;
+
+        auto* object = json.getDynamicObject();
+
+        if (object == nullptr)
+            return Result::fail ("Automation must be a JSON object of parameter names");
+
+        for (auto& property : object->getProperties())
+        {
+            const int parameter = findParameter (property.name.toString(), info);
+
+            if (parameter < 0)
+                return Result::fail ("Unknown parameter " + property.name.toString());
+
+            if (auto* points = property.value.getArray())
+            {
+                for (auto& point : *points)
+                {
+                    if (! point.isArray() || point.size() < 2)
+                        return Result::fail ("Automation of " + property.name.toString() + " must be [seconds, value] pairs");
+
+                    m_Points.add ({ (double) point[0], parameter, (t_param) (double) point[1] });
+                }
+            }
+            else
+            {
+                m_Points.add ({ 0.0, parameter, (t_param) (double) property.value });
+            }
+        }
+
+        return Result::ok();
+    }
+
+    Result parseCsv (const String& text, const GenParameterTable& info)
+    {
+        StringArray lines;
+        lines.addLines (text);
+
+        for (int i = 0; i < lines.size(); ++i)
+        {
+            StringArray fields;
+            fields.addTokens (lines[i], ",", "\"");
+            fields.trim();
+            fields.removeEmptyStrings (false);
+
+            if (fields.size() < 3 || ! fields[0].containsOnly ("0123456789.eE+-"))
+                continue;
+
+            const int parameter = findParameter (fields[1].unquoted(), info);
+
+            if (parameter < 0)
+                return Result::fail ("Unknown parameter " + fields[1] + " in line " + String (i + 1));
+
+            m_Points.add ({ fields[0].getDoubleValue(), parameter, (t_param) fields[2].getDoubleValue() });
+        }
+
+        return Result::ok();
+    }
+
+    static int findParameter (const String& name, const GenParameterTable& info)
+    {
+        for (int i = 0; i < info.size(); ++i)
+            if (info.getName (i) == name)
+                return i;
+
+        if (name.containsOnly ("0123456789") && isPositiveAndBelow (name.getIntValue(), info.size()))
+            return name.getIntValue();
+
+        return -1;
+    }
+
+    //==============================================================================
+    Array<Point> m_Points;
+};
+
+//==============================================================================
+/**
+    Runs an audio file (or silence) through a gen instance of its own and writes
+    the result as WAV or FLAC, picked by the output file's extension. Nothing
+    waits for a clock, so it renders as fast as perform() runs.
+
+    gen's inputs take the input file's channels in order, inputs beyond those
+    get silence. Automation changes are applied on the sample they fall on, by
+    splitting perform() there. The output is written to a temporary file first
+    and only replaces the target once rendering has succeeded.
+
+    Given an I/O thread, the input is read ahead and the output written behind
+    on that thread through ring buffers, so the disk works while perform()
+    does. Several renderers running at once can share one I/O thread.
+*/
+class GenOfflineRenderer
+{
+public:
+    //==============================================================================
+    struct Settings
+    {
+        File input;                     // none renders silence into gen's inputs
+        File output;
+        File automation;                // optional, see GenAutomation
+        int blockSize = 512;
+        double sampleRate = 48000.0;    // used without an input file
+        double lengthSeconds = 0;       // 0 renders the length of the input file
+        double tailSeconds = 0;         // rendered after the input ends
+        int bitsPerSample = 24;         // 32 writes floating point WAV
+    };
+
+    struct Stats
+    {
+        int64 numFrames = 0;
+        double sampleRate = 0;
+        double renderSeconds = 0;
+
+        /** How many times faster than real time the file was rendered. */
+        double getRealtimeMultiple() const noexcept
+        {
+            return renderSeconds > 0 ? numFrames / sampleRate / renderSeconds : 0;
+        }
+    };
+
+    //==============================================================================
+    explicit GenOfflineRenderer (TimeSliceThread* ioThread = nullptr)
+        : m_IOThread (ioThread)
+    {
+        m_FormatManager.registerBasicFormats();
+    }
+
+    /** Where the output is written until rendering has succeeded. */
+    static File getTemporaryFile (const File& output)
+    {
+        return output.getSiblingFile (output.getFileNameWithoutExtension() + "_rendering" + output.getFileExtension());
+    }
+
+    Result render (const Settings& settings, Stats& stats)
+    {
+        const int64 startTicks = Time::getHighResolutionTicks();
+        const int blockSize = jmax (1, settings.blockSize);
+
+        std::unique_ptr<AudioFormatReader> reader;
+
+        if (settings.input != File())
+        {
+            reader.reset (m_FormatManager.createReaderFor (settings.input));
+
+            if (reader == nullptr)
+                return Result::fail ("Can't read " + settings.input.getFullPathName());
+        }
+
+        const double sampleRate = reader != nullptr ? reader->sampleRate : settings.sampleRate;
+        const double lengthSeconds = settings.lengthSeconds > 0 ? settings.lengthSeconds
+                                   : reader != nullptr ? reader->lengthInSamples / sampleRate
+                                   : 0;
+        const int64 numFrames = (int64) std::ceil ((lengthSeconds + settings.tailSeconds) * sampleRate);
+
+        if (numFrames <= 0)
+            return Result::fail ("Nothing to render: give an input file or a length");
+
+        const int numInputs = C74_GENPLUGIN::num_inputs();
+        const int numOutputs = C74_GENPLUGIN::num_outputs();
+
+        std::unique_ptr<CommonState, void (*) (CommonState*)> state ((CommonState*) C74_GENPLUGIN::create (sampleRate, blockSize),
+                                                                     [] (CommonState* s) { C74_GENPLUGIN::destroy (s); });
+        C74_GENPLUGIN::reset (state.get());
+
+        const GenParameterTable info (state.get());
+        GenAutomation automation;
+
+        if (settings.automation != File())
+        {
+            const Result loaded = automation.load (settings.automation, info);
+
+            if (loaded.failed())
+                return loaded;
+        }
+
+        // named after the output rather than at random, as Random's system instance isn't thread safe
+        TemporaryFile temporary (settings.output, getTemporaryFile (settings.output));
+        std::unique_ptr<AudioFormatWriter> writer;
+        const Result opened = createWriter (temporary.getFile(), sampleRate, numOutputs, settings.bitsPerSample, writer);
+
+        if (opened.failed())
+            return opened;
+
+        const int ioBufferSize = jmax (ioBufferSamples, 4 * blockSize);
+        std::unique_ptr<ReadAhead> readAhead;
+        std::unique_ptr<WriteBehind> writeBehind;
+
+        if (m_IOThread != nullptr)
+        {
+            if (reader != nullptr)
+                readAhead.reset (new ReadAhead (*reader, *m_IOThread, numFrames, ioBufferSize));
+
+            writeBehind.reset (new WriteBehind (*writer, *m_IOThread, numOutputs, ioBufferSize));
+        }
+
+        GenBufferArena arena (numInputs, numOutputs);
+        arena.allocate (blockSize);
+
+        AudioBuffer<float> inputBlock (reader != nullptr ? (int) reader->numChannels : 0, blockSize);
+        AudioBuffer<float> outputBlock (numOutputs, blockSize);
+        HeapBlock<t_sample*> inputs (jmax (1, numInputs)), outputs (jmax (1, numOutputs));
+
+        const auto& points = automation.getPoints();
+        int nextPoint = 0;
+
+        for (int64 position = 0; position < numFrames; position += blockSize)
+        {
+            const int numSamples = (int) jmin ((int64) blockSize, numFrames - position);
+
+            // past its end, the reader fills in silence
+            if (readAhead != nullptr)
+                readAhead->read (inputBlock, numSamples);
+            else if (reader != nullptr)
+                reader->read (&inputBlock, 0, numSamples, position, true, true);
+
+            for (int i = 0; i < numInputs; ++i)
+            {
+                if (i < inputBlock.getNumChannels())
+                    convert (arena.getInputs()[i], inputBlock.getReadPointer (i), numSamples);
+                else
+                    FloatVectorOperations::clear (arena.getInputs()[i], numSamples);
+            }
+
+            for (int start = 0; start < numSamples; )
+            {
+                int end = numSamples;
+
+                for (; nextPoint < points.size(); ++nextPoint)
+                {
+                    const int64 pointPosition = (int64) std::llround (points.getReference (nextPoint).seconds * sampleRate);
+
+                    if (pointPosition > position + start)
+                    {
+                        end = (int) jmin ((int64) numSamples, pointPosition - position);
+                        break;
+                    }
+
+                    C74_GENPLUGIN::setparameter (state.get(), points.getReference (nextPoint).parameter,
+                                                 points.getReference (nextPoint).value, NULL);
+                }
+
+                for (int i = 0; i < numInputs; ++i)   inputs[i] = arena.getInputs()[i] + start;
+                for (int i = 0; i < numOutputs; ++i)  outputs[i] = arena.getOutputs()[i] + start;
+
+                C74_GENPLUGIN::perform (state.get(), inputs, numInputs, outputs, numOutputs, end - start);
+                start = end;
+            }
+
+            for (int i = 0; i < numOutputs; ++i)
+                convert (outputBlock.getWritePointer (i), arena.getOutputs()[i], numSamples);
+
+            const bool written = writeBehind != nullptr ? writeBehind->write (outputBlock, numSamples)
+                                                        : writer->writeFromAudioSampleBuffer (outputBlock, 0, numSamples);
+
+            if (! written)
+                return Result::fail ("Can't write " + settings.output.getFullPathName());
+        }
+
+        if (writeBehind != nullptr && ! writeBehind->finish())
+            return Result::fail ("Can't write " + settings.output.getFullPathName());
+
+        writeBehind.reset();
+        writer.reset();
+
+        if (! temporary.overwriteTargetFileWithTemporary())
+            return Result::fail ("Can't replace " + settings.output.getFullPathName());
+
+        stats.numFrames = numFrames;
+        stats.sampleRate = sampleRate;
+        stats.renderSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        return Result::ok();
+    }
+
+private:
+    //==============================================================================
+    /** Reads the input into a ring buffer on the I/O thread, ahead of the render. */
+    class ReadAhead  : private TimeSliceClient
+    {
+    public:
+        ReadAhead (AudioFormatReader& reader, TimeSliceThread& thread, int64 numFrames, int bufferSize)
+            : m_Reader (reader),
+              m_Thread (thread),
+              m_Buffer ((int) reader.numChannels, bufferSize),
+              m_Fifo (bufferSize),
+              m_NumFrames (numFrames)
+        {
+            m_Thread.addTimeSliceClient (this);
+        }
+
+        ~ReadAhead() override
+        {
+            m_Thread.removeTimeSliceClient (this);
+        }
+
+        /** Copies the next numSamples frames into dest, waiting for them if need be. */
+        void read (AudioBuffer<float>& dest, int numSamples)
+        {
+            while (m_Fifo.getNumReady() < numSamples)
+            {
+                m_Thread.moveToFrontOfQueue (this);
+                m_Ready.wait (10);
+            }
+
+            int start1, size1, start2, size2;
+            m_Fifo.prepareToRead (numSamples, start1, size1, start2, size2);
+
+            for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+            {
+                dest.copyFrom (ch, 0, m_Buffer, ch, start1, size1);
+                dest.copyFrom (ch, size1, m_Buffer, ch, start2, size2);
+            }
+
+            m_Fifo.finishedRead (size1 + size2);
+
+            if (m_Fifo.getFreeSpace() >= ioChunkSamples)
+                m_Thread.moveToFrontOfQueue (this);
+        }
+
+    private:
+        int useTimeSlice() override
+        {
+            const int numToRead = (int) jmin ((int64) jmin (m_Fifo.getFreeSpace(), ioChunkSamples), m_NumFrames - m_Position);
+
+            if (numToRead <= 0)
+                return m_Position < m_NumFrames ? 100 : -1;
+
+            int start1, size1, start2, size2;
+            m_Fifo.prepareToWrite (numToRead, start1, size1, start2, size2);
+
+            // past its end, the reader fills in silence
+            m_Reader.read (&m_Buffer, start1, size1, m_Position, true, true);
+
+            if (size2 > 0)
+                m_Reader.read (&m_Buffer, start2, size2, m_Position + size1, true, true);
+
+            m_Fifo.finishedWrite (size1 + size2);
+            m_Position += size1 + size2;
+            m_Ready.signal();
+            return 0;
+        }
+
+        AudioFormatReader& m_Reader;
+        TimeSliceThread& m_Thread;
+        AudioBuffer<float> m_Buffer;
+        AbstractFifo m_Fifo;
+        WaitableEvent m_Ready;
+        const int64 m_NumFrames;
+        int64 m_Position = 0;     // I/O thread only
+    };
+
+    /** Writes the output from a ring buffer on the I/O thread, behind the render. */
+    class WriteBehind  : private TimeSliceClient
+    {
+    public:
+        WriteBehind (AudioFormatWriter& writer, TimeSliceThread& thread, int numChannels, int bufferSize)
+            : m_Writer (writer),
+              m_Thread (thread),
+              m_Buffer (numChannels, bufferSize),
+              m_Fifo (bufferSize)
+        {
+            m_Thread.addTimeSliceClient (this);
+        }
+
+        ~WriteBehind() override
+        {
+            m_Thread.removeTimeSliceClient (this);
+        }
+
+        /** Queues numSamples frames of source, waiting for room if need be. Returns
+            false once writing has failed.
+        */
+        bool write (const AudioBuffer<float>& source, int numSamples)
+        {
+            while (m_Fifo.getFreeSpace() < numSamples && ! m_Failed)
+            {
+                m_Thread.moveToFrontOfQueue (this);
+                m_Written.wait (10);
+            }
+
+            int start1, size1, start2, size2;
+            m_Fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+
+            for (int ch = 0; ch < m_Buffer.getNumChannels(); ++ch)
+            {
+                m_Buffer.copyFrom (ch, start1, source, ch, 0, size1);
+                m_Buffer.copyFrom (ch, start2, source, ch, size1, size2);
+            }
+
+            m_Fifo.finishedWrite (size1 + size2);
+
+            if (m_Fifo.getNumReady() >= ioChunkSamples)
+                m_Thread.moveToFrontOfQueue (this);
+
+            return ! m_Failed;
+        }
+
+        /** Waits until everything queued is written. Returns false if writing failed. */
+        bool finish()
+        {
+            while (m_Fifo.getNumReady() > 0 && ! m_Failed)
+            {
+                m_Thread.moveToFrontOfQueue (this);
+                m_Written.wait (10);
+            }
+
+            return ! m_Failed;
+        }
+
+    private:
+        int useTimeSlice() override
+        {
+            int start1, size1, start2, size2;
+            m_Fifo.prepareToRead (jmin (m_Fifo.getNumReady(), ioChunkSamples), start1, size1, start2, size2);
+
+            if (size1 + size2 == 0)
+                return 100;
+
+            if (! m_Writer.writeFromAudioSampleBuffer (m_Buffer, start1, size1)
+                 || (size2 > 0 && ! m_Writer.writeFromAudioSampleBuffer (m_Buffer, start2, size2)))
+                m_Failed = true;
+
+            m_Fifo.finishedRead (size1 + size2);
+            m_Written.signal();
+            return 0;
+        }
+
+        AudioFormatWriter& m_Writer;
+        TimeSliceThread& m_Thread;
+        AudioBuffer<float> m_Buffer;
+        AbstractFifo m_Fifo;
+        WaitableEvent m_Written;
+        std::atomic<bool> m_Failed { false };
+    };
+
+    //==============================================================================
+    Result createWriter (const File& file, double sampleRate, int numChannels, int bitsPerSample,
+                         std::unique_ptr<AudioFormatWriter>& writer)
+    {
+        auto* format = m_FormatManager.findFormatForFileExtension (file.getFileExtension());
+
+        if (format == nullptr || ! (file.hasFileExtension ("wav") || file.hasFileExtension ("flac")))
+            return Result::fail ("Output must be a .wav or .flac file");
+
+        if (! format->getPossibleBitDepths().contains (bitsPerSample))
+            return Result::fail (format->getFormatName() + " can't be written with " + String (bitsPerSample) + " bits");
+
+        std::unique_ptr<FileOutputStream> stream (file.createOutputStream());
+
+        if (stream == nullptr)
+            return Result::fail ("Can't write " + file.getFullPathName());
+
+        writer.reset (format->createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels, bitsPerSample, {}, 0));
+
+        if (writer == nullptr)
+            return Result::fail ("Can't write " + String (numChannels) + " channels at " + String (sampleRate) + " Hz as " + format->getFormatName());
+
+        // the writer owns the stream now
+        stream.release();
+        return Result::ok();
+    }
+
+    static void convert (t_sample* dest, const float* src, int numSamples) noexcept
+    {
+       #ifdef GENLIB_USE_FLOAT32
+        FloatVectorOperations::copy (dest, src, numSamples);
+       #else
+        FloatVectorOperations::convert (dest, src, numSamples);
+       #endif
+    }
+
+   #ifndef GENLIB_USE_FLOAT32
+    static void convert (float* dest, const t_sample* src, int numSamples) noexcept
+    {
+        FloatVectorOperations::convert (dest, src, numSamples);
+    }
+   #endif
+
+    //==============================================================================
+    static constexpr int ioBufferSamples = 1 << 18;
+    static constexpr int ioChunkSamples = 1 << 14;
+
+    TimeSliceThread* const m_IOThread;
+    AudioFormatManager m_FormatManager;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GenOfflineRenderer)
+};
+
+
+#endif  // GENOFFLINERENDERER_H_INCLUDED
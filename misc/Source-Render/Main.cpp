@@ -0,0 +1,132 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    GenRender: renders audio files through the exported gen patch from the
+    command line, without a host or audio device.
+
+        GenRender --output=out.wav [--input=in.wav] [--automation=a.json]
+                  [--block-size=512] [--sample-rate=48000] [--length=seconds]
+                  [--tail=seconds] [--bits=24]
+
+        GenRender --manifest=jobs.json [--threads=cores] [options as defaults]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "GenBatchRenderer.h"
+#include "GenOfflineRenderer.h"
+
+#include <iostream>
+
+//==============================================================================
+namespace
+{
+    File getFile (const ArgumentList& args, StringRef option)
+    {
+        return args.containsOption (option) ? args.getFileForOption (option) : File();
+    }
+
+    GenOfflineRenderer::Settings getSettings (const ArgumentList& args)
+    {
+        GenOfflineRenderer::Settings settings;
+        settings.input = getFile (args, "--input");
+        settings.output = getFile (args, "--output");
+        settings.automation = getFile (args, "--automation");
+
+        if (args.containsOption ("--block-size"))     settings.blockSize = args.getValueForOption ("--block-size").getIntValue();
+        if (args.containsOption ("--sample-rate"))    settings.sampleRate = args.getValueForOption ("--sample-rate").getDoubleValue();
+        if (args.containsOption ("--length"))         settings.lengthSeconds = args.getValueForOption ("--length").getDoubleValue();
+        if (args.containsOption ("--tail"))           settings.tailSeconds = args.getValueForOption ("--tail").getDoubleValue();
+        if (args.containsOption ("--bits"))           settings.bitsPerSample = args.getValueForOption ("--bits").getIntValue();
+
+        if (settings.blockSize <= 0 || settings.sampleRate <= 0)
+            ConsoleApplication::fail ("Block size and sample rate must be positive");
+
+        return settings;
+    }
+
+    String describe (const GenOfflineRenderer::Stats& stats)
+    {
+        return String (stats.numFrames / stats.sampleRate, 2) + " s in "
+             + String (stats.renderSeconds, 2) + " s, "
+             + String (stats.getRealtimeMultiple(), 1) + "x real time";
+    }
+
+    void render (const ArgumentList& args)
+    {
+        args.failIfOptionIsMissing ("--output");
+        const auto settings = getSettings (args);
+
+        GenOfflineRenderer renderer;
+        GenOfflineRenderer::Stats stats;
+        const Result result = renderer.render (settings, stats);
+
+        if (result.failed())
+            ConsoleApplication::fail (result.getErrorMessage());
+
+        std::cout << settings.output.getFullPathName() << ": " << describe (stats) << std::endl;
+    }
+
+    void renderManifest (const ArgumentList& args)
+    {
+        const int numThreads = args.containsOption ("--threads") ? args.getValueForOption ("--threads").getIntValue()
+                                                                 : SystemStats::getNumCpus();
+
+        GenBatchRenderer batch (numThreads);
+        const Result loaded = batch.loadManifest (args.getExistingFileForOption ("--manifest"), getSettings (args));
+
+        if (loaded.failed())
+            ConsoleApplication::fail (loaded.getErrorMessage());
+
+        const int64 startTicks = Time::getHighResolutionTicks();
+
+        const int numFailed = batch.renderAll ([] (const GenBatchRenderer::Job& job)
+        {
+            std::cout << job.settings.output.getFullPathName() << ": "
+                      << (job.result.wasOk() ? describe (job.stats) : "failed, " + job.result.getErrorMessage()) << std::endl;
+        });
+
+        const double wallSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+        double audioSeconds = 0;
+
+        for (int i = 0; i < batch.getNumJobs(); ++i)
+            if (batch.getJob (i).result.wasOk())
+                audioSeconds += batch.getJob (i).stats.numFrames / batch.getJob (i).stats.sampleRate;
+
+        std::cout << batch.getNumJobs() << " jobs on " << jmax (1, numThreads) << " threads: "
+                  << String (audioSeconds, 2) << " s in " << String (wallSeconds, 2) << " s, "
+                  << String (wallSeconds > 0 ? audioSeconds / wallSeconds : 0.0, 1) << "x real time"
+                  << (numFailed > 0 ? ", " + String (numFailed) + " failed" : String()) << std::endl;
+
+        if (numFailed > 0)
+            ConsoleApplication::fail ("Not every job was rendered");
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    ConsoleApplication app;
+
+    app.addHelpCommand ("--help|-h",
+                        "Renders audio files through the exported gen patch.\n\n"
+                        "Usage: GenRender --output=out.wav [--input=in.wav] [--automation=a.json|a.csv]\n"
+                        "                 [--block-size=512] [--sample-rate=48000] [--length=seconds]\n"
+                        "                 [--tail=seconds] [--bits=24]\n"
+                        "       GenRender --manifest=jobs.json [--threads=cores] [options as defaults]",
+                        false);
+
+    app.addCommand ({ "--manifest", "--manifest=jobs.json [--threads=cores] [options]",
+                      "Renders the jobs of a manifest, several at once", {},
+                      [] (const ArgumentList& args) { renderManifest (args); } });
+
+    app.addDefaultCommand ({ "--output", "--output=out.wav [options]",
+                             "Renders one file, WAV or FLAC by its extension", {},
+                             [] (const ArgumentList& args) { render (args); } });
+
+    return app.findAndRunCommand (argc, argv);
+}
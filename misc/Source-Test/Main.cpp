@@ -0,0 +1,27 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    GenTests: runs the unit tests of the shared gen code, and fails if any
+    of them does.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+//==============================================================================
+int main (int, char*[])
+{
+    UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runTestsInCategory ("gen");
+
+    int numFailures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/*
+  ==============================================================================
+
+    SampleLoaderTests.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "GenSampleLoader.h"
+
+//==============================================================================
+class GenSampleLoaderTests  : public UnitTest
+{
+public:
+    GenSampleLoaderTests()
+        : UnitTest ("GenSampleLoader", "gen")
+    {
+    }
+
+    void runTest() override
+    {
+        // more than one block's worth of binds, as when a preset restores every
+        // buffer before playback starts. The loader binds by index whether or
+        // not the patch has a buffer there, which gen ignores.
+        constexpr int numParams = 24;
+
+        const File directory (File::getSpecialLocation (File::tempDirectory)
+                                .getChildFile ("gen-sample-loader-test-" + String::toHexString (Time::currentTimeMillis())));
+        directory.createDirectory();
+
+        // held here so it outlives the loader, and what the loader leaked shows
+        SharedResourcePointer<GenSamplePool> pool;
+        auto* state = (CommonState*) C74_GENPLUGIN::create (44100, 64);
+
+        {
+            GenSampleLoader loader (numParams);
+
+            for (int round = 0; round < 3; ++round)
+            {
+                beginTest ("Binding " + String (numParams) + " loads at once, round " + String (round + 1));
+
+                Array<File> files;
+
+                for (int i = 0; i < numParams; ++i)
+                {
+                    files.add (directory.getChildFile ("r" + String (round) + "_" + String (i) + ".wav"));
+                    writeFile (files.getLast(), i + 1);
+                    loader.load (i, files.getLast(), round == 0);
+                }
+
+                expect (waitUntilLoaded (loader, files), "The files weren't loaded in time");
+                expect (loader.bindPending (state));
+
+                for (int i = 0; i < numParams; ++i)
+                    expect (loader.getFile (i) == files[i]);
+            }
+        }
+
+        // patches may poke into shared buffers, which the cache file never sees
+        beginTest ("Writing into pooled samples");
+
+        {
+            const File file (directory.getChildFile ("written.wav"));
+            writeFile (file, 64);
+
+            auto entry = pool->acquire (file, [] { return false; });
+            expect (entry != nullptr);
+
+            if (entry != nullptr)
+            {
+                for (int64 n = 0; n < entry->getNumFrames(); ++n)
+                    entry->getSamples()[n] = (t_sample) -1;
+
+                expectEquals ((double) entry->getSamples()[entry->getNumFrames() - 1], -1.0);
+            }
+        }
+
+        pool->purgeUnused();
+
+        beginTest ("Everything replaced was freed");
+        expectEquals (pool->getStatistics().numEntries, 0);
+
+        C74_GENPLUGIN::destroy (state);
+        directory.deleteRecursively();
+    }
+
+private:
+    static void writeFile (const File& file, int numFrames)
+    {
+        AudioBuffer<float> buffer (1, numFrames);
+
+        for (int n = 0; n < numFrames; ++n)
+            buffer.setSample (0, n, n / (float) numFrames);
+
+        WavAudioFormat wav;
+        std::unique_ptr<AudioFormatWriter> writer (wav.createWriterFor (new FileOutputStream (file), 44100, 1, 16, {}, 0));
+        writer->writeFromAudioSampleBuffer (buffer, 0, numFrames);
+    }
+
+    static bool waitUntilLoaded (const GenSampleLoader& loader, const Array<File>& files)
+    {
+        for (int attempt = 0; attempt < 1000; ++attempt)
+        {
+            bool allLoaded = true;
+
+            for (int i = 0; i < files.size() && allLoaded; ++i)
+                allLoaded = loader.getFile (i) == files[i];
+
+            if (allLoaded)
+                return true;
+
+            Thread::sleep (10);
+        }
+
+        return false;
+    }
+};
+
+static GenSampleLoaderTests genSampleLoaderTests;
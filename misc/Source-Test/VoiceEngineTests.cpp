@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    VoiceEngineTests.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "GenVoiceEngine.h"
+
+//==============================================================================
+class GenVoiceEngineTests  : public UnitTest
+{
+public:
+    GenVoiceEngineTests()
+        : UnitTest ("GenVoiceEngine", "gen")
+    {
+    }
+
+    void runTest() override
+    {
+        auto* state = (CommonState*) C74_GENPLUGIN::create (44100, 64);
+        const GenParameterTable info (state);
+
+        // the processor renders whole host blocks, which may be longer than the
+        // block size it was prepared for when the host splits them differently
+        beginTest ("Rendering past the prepared block size with workers");
+
+        const AudioBuffer<float> alone = renderVoices (info, 0);
+        const AudioBuffer<float> withWorkers = renderVoices (info, 3);
+
+        for (int ch = 0; ch < alone.getNumChannels(); ++ch)
+            for (int n = 0; n < numSamples; ++n)
+                expectWithinAbsoluteError (withWorkers.getSample (ch, n), alone.getSample (ch, n), 1.0e-5f);
+
+        // voices play instances of their own, which a restored state has to reach
+        beginTest ("Copying a state to every voice");
+
+        for (int i = 0; i < info.size(); ++i)
+            C74_GENPLUGIN::setparameter (state, i, (info.getMin (i) + info.getMax (i)) / 2, NULL);
+
+        GenVoiceEngine engine (info, numVoices, 0, false);
+        engine.copyState (state);
+
+        // parameters MIDI plays are left to the voices
+        const GenMidiMapping mapping (info, C74_GENPLUGIN::num_inputs());
+
+        for (int v = 0; v < numVoices; ++v)
+        {
+            for (int i = 0; i < info.size(); ++i)
+            {
+                if (mapping.drivesParameter (i))
+                    continue;
+
+                t_param expected, actual;
+                C74_GENPLUGIN::getparameter (state, i, &expected);
+                C74_GENPLUGIN::getparameter (engine.getVoiceState (v), i, &actual);
+                expectEquals ((double) actual, (double) expected);
+            }
+        }
+
+        C74_GENPLUGIN::destroy (state);
+    }
+
+private:
+    static constexpr int numVoices = 8;
+    static constexpr int preparedBlockSize = 64;
+    static constexpr int renderedBlockSize = 256;
+    static constexpr int numSamples = 4 * renderedBlockSize;
+
+    /** Holds every voice and renders numSamples in blocks four times the
+        prepared size.
+    */
+    static AudioBuffer<float> renderVoices (const GenParameterTable& info, int numThreads)
+    {
+        GenVoiceEngine engine (info, numVoices, numThreads, false);
+        engine.prepare (44100, preparedBlockSize);
+
+        AudioBuffer<float> buffer (jmax (1, C74_GENPLUGIN::num_outputs()), numSamples);
+        MidiBuffer midi;
+
+        for (int v = 0; v < numVoices; ++v)
+            midi.addEvent (MidiMessage::noteOn (1, 48 + v, (uint8) 100), v * 10);
+
+        for (int start = 0; start < numSamples; start += renderedBlockSize)
+            engine.render (buffer, midi, start, renderedBlockSize);
+
+        return buffer;
+    }
+};
+
+static GenVoiceEngineTests genVoiceEngineTests;